@@ -7,4 +7,19 @@ extern "C" {
 int get_nthread();
 int get_port();
 void get_logfile(char *log_filename);
+int get_filecache_size();
+int get_filecache_revalidate_ms();
+int get_reuseport();
+void get_dispatch_policy(char *policy_name, int len);
+void get_poller_backend(char *backend_name, int len);
+int get_oneshot();
+int get_precompress();
+int get_gzip();
+int get_gzip_cache_size();
+int get_gzip_budget();
+int get_server_status();
+int get_upload();
+int get_body_max_size();
+int get_body_spool_threshold();
+void get_body_spool_dir(char *dir, int len);
 }
\ No newline at end of file
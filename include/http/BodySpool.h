@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "noncopyable.h"
+
+
+constexpr size_t BODY_SPOOL_DEFAULT_THRESHOLD = 64 * 1024;
+
+
+/**
+ * @brief 请求体的暂存区，由需要完整请求体的处理者使用。
+        不超过 threshold 的请求体保存在内存中，超过后把已有的数据和之后的数据都写入 dir 中的临时文件，
+        每个连接占用的内存不随请求体的大小增长。
+        临时文件使用 O_TMPFILE 创建，没有文件名，关闭或者进程退出时自动删除。
+ *
+ */
+class BodySpool : private Noncopyable {
+public:
+    BodySpool(size_t threshold, std::string dir);
+    ~BodySpool();
+
+    // 写入临时文件失败返回 false
+    bool append(std::string_view data);
+
+    [[nodiscard]] size_t size() const noexcept { return m_size; }
+    [[nodiscard]] bool spooled() const noexcept { return m_fd >= 0; }
+    // spooled() 为 true 时请求体在临时文件中，从 offset 0 开始用 pread 读取
+    [[nodiscard]] int fd() const noexcept { return m_fd; }
+    [[nodiscard]] const std::string &memory() const noexcept { return m_memory; }
+
+private:
+    bool open_spool_file();
+
+    size_t m_threshold;
+    std::string m_dir;
+
+    std::string m_memory;
+    int m_fd{-1};
+    size_t m_size{0};
+};
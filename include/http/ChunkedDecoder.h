@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+
+constexpr size_t CHUNKED_MAX_LINE = 4096;       // chunk 长度行 (含扩展) 的最大长度
+constexpr size_t CHUNKED_MAX_TRAILER = 8192;    // 所有 trailer 行的最大总长度
+
+
+/**
+ * @brief Transfer-Encoding: chunked 请求体的增量解码器。
+        输入是接收缓冲区中未处理的数据，每次 decode 最多得到一段数据，数据直接指向输入，不拷贝。
+        调用者处理完数据后从缓冲区中移除已消耗的字节，数据不完整时等待更多输入后继续。
+        chunk 扩展和 trailer 被忽略。
+ *
+ */
+class ChunkedDecoder {
+public:
+    void reset() noexcept;
+
+    // 从 input 的开头解码，data 是得到的数据 (指向 input，最多 max_data 字节)，返回消耗的字节数 (包括 data)。
+    // 返回 0 且 data 为空时需要更多输入；格式错误时 error() 为 true
+    size_t decode(std::string_view input, size_t max_data, std::string_view &data) noexcept;
+
+    [[nodiscard]] bool done() const noexcept { return m_state == State::DONE; }
+    [[nodiscard]] bool error() const noexcept { return m_state == State::ERROR; }
+
+private:
+    enum class State { SIZE_LINE, DATA, DATA_CRLF, TRAILER, DONE, ERROR };
+
+    // 解析 "1a2b;ext=1\r"，格式错误或者溢出返回 false
+    static bool parse_size_line(std::string_view line, size_t &size) noexcept;
+
+    State m_state{State::SIZE_LINE};
+    size_t m_chunk_remain{0};
+    size_t m_trailer_bytes{0};
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unordered_map>
+
+#include "Mutex.h"
+#include "noncopyable.h"
+
+
+constexpr size_t FILECACHE_DEFAULT_CAPACITY = 1024;
+constexpr int FILECACHE_DEFAULT_REVALIDATE_MS = 2000;
+constexpr size_t FILECACHE_INLINE_SIZE = 16 * 1024;  // 不超过这个大小的文件，内容保存在内存中
+
+// 预压缩的同名文件 (a.css.br、a.css.zst、a.css.gz)，按协商时的优先顺序
+constexpr size_t CONTENT_ENCODING_COUNT = 3;
+constexpr std::array<std::string_view, CONTENT_ENCODING_COUNT> CONTENT_ENCODING_NAMES{"br", "zstd", "gzip"};
+constexpr std::array<std::string_view, CONTENT_ENCODING_COUNT> CONTENT_ENCODING_SUFFIXES{".br", ".zst", ".gz"};
+
+
+// 缓存的静态文件，打开的 fd 一直保留到条目被淘汰，且没有连接在发送它
+// sendfile 使用自己的 offset，多个线程共享同一个 fd 是安全的
+struct CachedFile : private Noncopyable {
+    // encoding 不为空时是预压缩的版本；vary 为 true 时响应带 Vary: Accept-Encoding
+    CachedFile(int file_fd, const struct stat &st, std::string mime,
+               std::string_view encoding = {}, bool vary = false);
+    // 只在内存中的编码版本 (动态压缩的结果)，没有 fd，ETag 由原文件的 ETag 加上编码名
+    CachedFile(const CachedFile &source, std::string_view encoding, std::string encoded_content);
+    ~CachedFile();
+
+    [[nodiscard]] bool has_encoded() const noexcept {
+        for (const auto &file: encoded) {
+            if (file) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int fd;
+    size_t size;
+    time_t mtime;
+    ino_t inode;
+    std::string mime_type;
+
+    // 强校验的 ETag，由 inode、大小和修改时间生成，如 "\"1a2b-22bd-5f5e1000\""
+    std::string etag;
+
+    // 预先生成的响应头部分: Content-Type, Content-Encoding, Content-Length, Accept-Ranges, Vary,
+    // Server, Last-Modified, ETag
+    std::string header;
+    // 304、206 和 416 响应共用的头部分: Content-Encoding, Vary, Server, Last-Modified, ETag，其余的头由连接生成
+    std::string common_header;
+    // 小文件的内容，和响应头一起用 writev 发送。为空时用 sendfile 发送
+    std::string content;
+
+    // 可压缩类型的预压缩版本，下标和 CONTENT_ENCODING_NAMES 对应，没有或者不是新鲜的时为空
+    std::array<std::shared_ptr<const CachedFile>, CONTENT_ENCODING_COUNT> encoded;
+
+private:
+    void build_headers(std::string_view encoding, bool vary);
+};
+
+
+/**
+ * @brief 进程内所有 EventLoopThread 共享的静态文件缓存。
+        以规范化后的路径为 key，保存打开的 fd、文件元数据和预生成的响应头，
+        超过 revalidate 间隔后重新 stat 校验，容量满时按 LRU 淘汰。
+        命中时不需要 stat/open/close 系统调用。
+        可压缩的文件在加载时同时打开新鲜的 .br/.zst/.gz 同名文件 (见 is_encoded_fresh)，之后新增的压缩文件
+        在原文件修改、条目被淘汰或者调用 invalidate 之后才会使用。
+ *
+ */
+class FileCache : private Noncopyable {
+public:
+    using CachedFilePtr = std::shared_ptr<const CachedFile>;
+
+    static FileCache &instance();
+
+    void set_capacity(size_t capacity) noexcept { m_capacity = capacity > 0 ? capacity : 1; }
+    void set_revalidate_interval(int ms) noexcept { m_revalidate_ms = ms; }
+
+    // 文件不存在或者不是普通文件，返回 nullptr
+    CachedFilePtr get(std::string_view filename);
+    // 移除条目，下次 get 时重新加载，比如生成了新的预压缩文件
+    void invalidate(std::string_view filename);
+
+    [[nodiscard]] uint64_t hits() const noexcept { return m_hits.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t misses() const noexcept { return m_misses.load(std::memory_order_relaxed); }
+
+    static void normalize_path(std::string_view filename, std::string &path);
+    static std::string find_mime_type(const std::string &path);
+    // 文本类的 MIME 类型压缩效果好，图片、视频等已经压缩过的类型不处理
+    static bool is_compressible(const std::string &mime_type);
+    // 压缩文件的修改时间和原文件完全相同 (秒和纳秒) 时才是新鲜的。Precompressor 用 futimens 复制原文件的
+    // 修改时间，gzip/brotli/zstd -k 也保留原文件的修改时间；原文件修改，即使在同一秒内或者换成更早的版本，都不再相同
+    static bool is_encoded_fresh(const struct stat &source, const struct stat &encoded);
+
+private:
+    FileCache() = default;
+
+    struct Entry {
+        CachedFilePtr file;
+        int64_t validated_ms;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    static CachedFilePtr open_file(const std::string &path);
+    void insert_guarded(const std::string &path, const CachedFilePtr &file, int64_t now);
+    void erase_guarded(const std::string &path);
+    void count_lookup(bool hit);
+
+    size_t m_capacity{FILECACHE_DEFAULT_CAPACITY};
+    int m_revalidate_ms{FILECACHE_DEFAULT_REVALIDATE_MS};
+
+    mutable Mutex m_mutex{};
+    std::unordered_map<std::string, Entry> m_entries;
+    std::list<std::string> m_lru;  // front 是最近使用的
+
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "FileCache.h"
+#include "Mutex.h"
+#include "noncopyable.h"
+
+
+constexpr size_t GZIP_MIN_SIZE = 1024;                        // 更小的响应压缩节省不了多少
+constexpr size_t GZIP_MAX_SIZE = 256 * 1024;                  // 更大的文件应该预压缩，一次压缩的停顿在几 ms 之内
+constexpr size_t GZIP_DEFAULT_CAPACITY = 32 * 1024 * 1024;    // 缓存的压缩结果总字节数
+constexpr size_t GZIP_DEFAULT_BUDGET = 16 * 1024 * 1024;      // 每个 loop 线程每秒最多压缩的输入字节数
+constexpr int GZIP_LEVEL = 6;
+
+
+/**
+ * @brief 没有预压缩版本的文件在请求时用 zlib 压缩，结果按 LRU 缓存，所有 EventLoopThread 共享。
+        key 是规范化的路径、原文件的 ETag (inode、大小、修改时间) 和编码名，文件修改后自然失效。
+        压缩在 loop 线程中同步进行: GZIP_MAX_SIZE 限制每次压缩让 loop 停顿的时间，
+        每个线程的令牌桶在压缩之前按输入字节数扣除，限制每秒压缩的总量，
+        超出预算时返回 nullptr，这次请求发送未压缩的版本。
+        压缩结果是只在内存中的 CachedFile，Content-Length 已知，条件请求和 Range 照常处理。
+ *
+ */
+class GzipCache : private Noncopyable {
+public:
+    static GzipCache &instance();
+
+    // 编译时没有 zlib 时不能打开
+    void set_enabled(bool enabled) noexcept;
+    void set_capacity(size_t bytes) noexcept { m_capacity = bytes; }
+    void set_budget(size_t bytes_per_second) noexcept { m_budget = bytes_per_second; }
+
+    // 可以动态压缩的文件: 可压缩类型，大小在 GZIP_MIN_SIZE 和 GZIP_MAX_SIZE 之间
+    [[nodiscard]] bool is_candidate(const std::string &mime_type, size_t size) const noexcept;
+
+    // 返回 file 的 gzip 版本，filename 是请求的文件名。未命中时在当前线程压缩，
+    // 超出本线程的预算、压缩失败或者压缩后没有变小时返回 nullptr
+    FileCache::CachedFilePtr get(std::string_view filename, const FileCache::CachedFilePtr &file);
+
+    [[nodiscard]] uint64_t hits() const noexcept { return m_hits.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t misses() const noexcept { return m_misses.load(std::memory_order_relaxed); }
+
+    // gzip 格式压缩，level 同 zlib 的压缩级别
+    static bool compress(std::string_view input, std::string &output, int level);
+
+private:
+    GzipCache() = default;
+
+    struct Entry {
+        FileCache::CachedFilePtr file;   // 压缩后没有变小时为空，避免重复压缩
+        size_t charge;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    bool take_budget(size_t bytes) const noexcept;
+    void insert_guarded(const std::string &key, const FileCache::CachedFilePtr &file, size_t charge);
+
+    bool m_enabled{false};
+    size_t m_capacity{GZIP_DEFAULT_CAPACITY};
+    size_t m_budget{GZIP_DEFAULT_BUDGET};
+
+    mutable Mutex m_mutex{};
+    std::unordered_map<std::string, Entry> m_entries;
+    std::list<std::string> m_lru;  // front 是最近使用的
+    size_t m_size{0};              // 所有条目的 charge 之和
+
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
@@ -1,19 +1,26 @@
 #pragma once
 
+#include <deque>
 #include <functional>
-#include <map>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <unordered_map>
-
+#include <vector>
+
+#include "Buffer.h"
+#include "Channel.h"
+#include "ChunkedDecoder.h"
+#include "FileCache.h"
+#include "HttpParser.h"
+#include "HttpRange.h"
+#include "MemoryPool.h"
 #include "Timer.h"
 
 class EventLoop;
-class TimerNode;
-class Channel;
 
 enum class ProcessState {
     STATE_PARSE_URI = 1,
@@ -23,37 +30,11 @@ enum class ProcessState {
     STATE_FINISH
 };
 
-enum class URIState {
-    PARSE_URI_AGAIN = 1,
-    PARSE_URI_ERROR,
-    PARSE_URI_SUCCESS,
-};
-
-enum class HeaderState {
-    PARSE_HEADER_SUCCESS = 1,
-    PARSE_HEADER_AGAIN,
-    PARSE_HEADER_ERROR
-};
-
 enum class AnalysisState { ANALYSIS_SUCCESS = 1, ANALYSIS_ERROR };
 
-enum class ParseState {
-    H_START = 0,
-    H_KEY,
-    H_COLON,
-    H_SPACES_AFTER_COLON,
-    H_VALUE,
-    H_CR,
-    H_LF,
-    H_END_CR,
-    H_END_LF
-};
-
 enum class ConnectionState { H_CONNECTED = 0, H_DISCONNECTING, H_DISCONNECTED };
 
-enum class HttpMethod { METHOD_POST = 1, METHOD_GET, METHOD_HEAD };
-
-enum class HttpVersion { HTTP_10 = 1, HTTP_11 };
+constexpr size_t BODY_DEFAULT_MAX_SIZE = 10 * 1024 * 1024;
 
 
 class MimeType {
@@ -64,25 +45,64 @@ private:
 
 public:
     static std::string get_mime_type(const std::string &suffix);
+    static bool contains(const std::string &suffix);
+};
+
+
+// 待发送的响应片段: 内存中的数据，或者由 sendfile 直接从 page cache 发送的文件区域
+// 连续的内存片段用一次 sendmsg 发送，未发送完的进度保存在 segment 中，EPOLLOUT 时继续发送
+struct OutputSegment {
+    std::string data;               // 连接自己生成的数据，比如 Date 头、错误页面
+    size_t data_sent{0};
+    std::string_view view;          // 不拷贝的数据: 静态字符串，或者由 owner 持有
+    std::shared_ptr<const void> owner;
+
+    FileCache::CachedFilePtr file;  // 要发送的文件，fd 由 FileCache 持有
+    off_t file_offset{0};
+    size_t file_remain{0};          // 不为 0 时是文件区域
+
+    [[nodiscard]] std::string_view pending_data() const noexcept {
+        return data.empty() ? view : std::string_view(data).substr(data_sent);
+    }
 };
 
 
 class HttpData : public std::enable_shared_from_this<HttpData> {
 public:
+    // 流式响应的数据源: 每次调用在 chunk 中追加下一段数据，返回 false 表示这是最后一段。
+    // 发送队列清空后才会再次调用，生成的速度由客户端接收的速度决定
+    using StreamProducer = std::function<bool(std::string &chunk)>;
+    // 为一个请求创建数据源
+    using StreamHandler = std::function<StreamProducer()>;
+
+    // POST 请求体的处理者: 按顺序收到请求体的片段 (每段最多 64 KB)，收到之后数据不再保留。
+    // 请求体结束时 last 为 true (data 为空)，在 response 中写入响应体 (text/plain)。返回 false 时响应 500
+    using BodyConsumer = std::function<bool(std::string_view data, bool last, std::string &response)>;
+    // 为一个请求创建处理者
+    using BodyHandler = std::function<BodyConsumer()>;
+
     HttpData(EventLoop *loop, int connfd);
-    ~HttpData() {
-        shutdown(m_connfd, SHUT_RDWR);
-        close(m_connfd);
-    }
+    ~HttpData();
+
+    // true: 连接使用 EPOLLONESHOT，每个事件之后重新注册
+    // false: 持续注册的边沿触发，只在增加或去掉 EPOLLOUT 时修改。在创建连接之前设置
+    static void set_oneshot(bool oneshot) noexcept { s_oneshot = oneshot; }
+
+    // 长度未知的响应，HTTP/1.1 使用 Transfer-Encoding: chunked，HTTP/1.0 以关闭连接结束。
+    // path 不含开头的 '/'，在 Server::start 之前注册
+    static void register_stream_handler(std::string path, std::string content_type, StreamHandler handler);
+    // 没有注册的路径的 POST 响应 403。path 不含开头的 '/'，在 Server::start 之前注册
+    static void register_body_handler(std::string path, BodyHandler handler);
+    // 请求体的最大字节数，Content-Length 超过时直接响应 413，chunked 请求体在超过时中止
+    static void set_max_body_size(size_t bytes) noexcept { s_max_body_size = bytes; }
     
     void reset();
 
-    void detach_timer();
-    void link_timer(const std::shared_ptr<TimerNode>& timer) {
-        m_timer = timer;
-    };
+    void detach_timer() { m_timer.cancel(); }
+    TimerNode &get_timer() { return m_timer; }
 
-    std::shared_ptr<Channel> get_channel() { return m_channel; }
+    // Channel 是 HttpData 的成员，返回的 shared_ptr 和 HttpData 共享引用计数
+    std::shared_ptr<Channel> get_channel() { return std::shared_ptr<Channel>(shared_from_this(), &m_channel); }
 
     EventLoop *get_loop() { return m_event_loop; }
 
@@ -93,28 +113,91 @@ private:
     void handle_read();
     void handle_write();
     void handle_connect();
-    void handle_error(int fd, int err_num, std::string short_msg);
+    void handle_error(int err_num, std::string short_msg);
+
+    // 处理 m_in_buf 中所有完整的请求 (pipelining)，流式响应发送完之前后面的请求等待
+    void process_requests();
+    bool process_request();
+
+    // 响应按请求顺序排队，流水线请求的响应在一次 flush 中写出
+    void append_output(std::string_view data);
+    // data 需要在发送完之前保持有效: 静态字符串，或者由 owner 持有
+    void append_output_view(std::string_view data, std::shared_ptr<const void> owner = nullptr);
+    void append_output_file(FileCache::CachedFilePtr file, off_t offset, size_t length);
+    bool flush_output();
+    // 从队首移除已发送的 n 字节内存数据
+    void consume_output(size_t n);
+    // 状态行、Connection、extra_header (拷贝)、header、Date 和空行
+    void append_response_head(std::string_view status_line, std::string_view header,
+                              std::shared_ptr<const void> owner, std::string_view extra_header = {});
+    // 文件的一段: 小文件引用缓存的内容，大文件用 sendfile 发送
+    void append_file_body(const FileCache::CachedFilePtr &file, size_t offset, size_t length);
+    // 206 响应，一个区间直接发送，多个区间使用 multipart/byteranges
+    void append_partial_content(const FileCache::CachedFilePtr &file, const ByteRanges &ranges);
+    void append_range_not_satisfiable(const FileCache::CachedFilePtr &file);
+    // 条件请求 (If-None-Match / If-Modified-Since) 的校验结果
+    bool is_not_modified(const CachedFile &file);
+    // 没有 If-Range，或者 If-Range 和文件当前的版本一致时 Range 才有效
+    bool if_range_matches(const CachedFile &file);
+    // 按 Accept-Encoding 选择预压缩的版本，客户端都不接受时返回原文件
+    FileCache::CachedFilePtr select_encoding(std::string_view filename, FileCache::CachedFilePtr file);
+    // 找到注册的流式响应时发送响应头并开始生成，返回 false 表示没有这个路径
+    bool start_stream(std::string_view path);
+    // 生成流式响应的数据直到超过高水位或者结束，每段数据加上 chunk 的长度行
+    void produce_stream();
+    // POST 请求头处理完时调用: 找到处理者，检查 Content-Length / Transfer-Encoding / Expect
+    bool begin_body();
+    bool receive_body();
+    bool deliver_body(std::string_view data);
+    // 请求体结束，由处理者生成响应
+    bool finish_body();
+    // m_pending_bytes 的变化同步到 EventLoop 的负载统计
+    void update_pending_bytes(int64_t delta);
+    [[nodiscard]] bool has_pending_output() const noexcept { return !m_out_queue.empty(); }
 
     URIState parse_URI();
     HeaderState parse_headers();
     AnalysisState analysis_request();
 
+    struct StreamRoute {
+        std::string path;
+        std::string header;   // Content-Type, Transfer-Encoding, Server
+        std::string header_http10;
+        StreamHandler handler;
+    };
+
+    struct BodyRoute {
+        std::string path;
+        BodyHandler handler;
+    };
+
+    static bool s_oneshot;
+    static std::vector<StreamRoute> s_stream_routes;
+    static std::vector<BodyRoute> s_body_routes;
+    static size_t s_max_body_size;
+
     bool m_closed{false};
 
-    std::string m_in_buf;
-    std::string m_out_buf;
+    Buffer m_in_buf;   // 块来自所属 EventLoop 的 MemoryPool，请求处理完后归还
+    std::deque<OutputSegment, PoolAllocator<OutputSegment>> m_out_queue;
+    size_t m_pending_bytes{0};   // m_out_queue 中未发送的字节数
+
+    StreamProducer m_stream;      // 正在发送的流式响应，为空时没有
+    bool m_stream_chunked{true};
+    std::string m_stream_chunk;   // 数据源写入的缓冲区，每段复用
 
-    std::string m_filename;
-    std::string m_path;
+    BodyConsumer m_body_consumer;   // 正在接收的请求体的处理者
+    bool m_body_chunked{false};
+    size_t m_body_remaining{0};     // Content-Length 请求体未接收的字节数
+    size_t m_body_received{0};
+    ChunkedDecoder m_chunked_decoder;
 
-    std::weak_ptr<TimerNode> m_timer;
-    std::shared_ptr<Channel> m_channel;
+    TimerNode m_timer;   // 超时后关闭连接
+    Channel m_channel;
 
     EventLoop* m_event_loop;
     int m_connfd;
 
-    int m_read_pos{0};
-
     bool m_error{false};
     bool m_keep_alive{false};
 
@@ -123,8 +206,8 @@ private:
     HttpVersion m_http_version{HttpVersion::HTTP_11};
     
     ProcessState m_process_state{ProcessState::STATE_PARSE_URI};
-    ParseState m_parse_state{ParseState::H_START};
 
-    std::map<std::string, std::string> m_headers;
+    // 解析结果是 m_in_buf 中的偏移，请求应答完毕后才从 m_in_buf 中 retrieve
+    HttpRequestParser m_parser;
 };
 
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+
+enum class URIState {
+    PARSE_URI_AGAIN = 1,
+    PARSE_URI_ERROR,
+    PARSE_URI_SUCCESS,
+};
+
+enum class HeaderState {
+    PARSE_HEADER_SUCCESS = 1,
+    PARSE_HEADER_AGAIN,
+    PARSE_HEADER_ERROR
+};
+
+enum class HttpMethod { METHOD_POST = 1, METHOD_GET, METHOD_HEAD };
+
+enum class HttpVersion { HTTP_10 = 1, HTTP_11 };
+
+
+// 请求行加请求头的最大长度，超过后按错误请求处理
+constexpr size_t MAX_REQUEST_HEADER_SIZE = 8192;
+
+
+/**
+ * @brief 请求头的扁平查找表，只记录 key/value 在接收缓冲区中的偏移，不做堆分配。
+        key 的查找不区分大小写，查询前需要用 rebase 绑定当前接收缓冲区的起始地址。
+ *
+ */
+class HttpHeaders {
+public:
+    static constexpr size_t MAX_FIELDS = 64;
+
+    void clear() noexcept { m_count = 0; }
+    void rebase(const char *base) noexcept { m_base = base; }
+
+    // 表满时返回 false
+    bool add(size_t key_off, size_t key_len, size_t value_off, size_t value_len) noexcept;
+
+    // 不存在时返回空 string_view
+    [[nodiscard]] std::string_view get(std::string_view key) const noexcept;
+    [[nodiscard]] bool contains(std::string_view key) const noexcept;
+
+    [[nodiscard]] size_t size() const noexcept { return m_count; }
+    [[nodiscard]] std::string_view key(size_t i) const noexcept {
+        return {m_base + m_fields[i].key_off, m_fields[i].key_len};
+    }
+    [[nodiscard]] std::string_view value(size_t i) const noexcept {
+        return {m_base + m_fields[i].value_off, m_fields[i].value_len};
+    }
+
+    static bool equals_ignore_case(std::string_view a, std::string_view b) noexcept;
+
+private:
+    struct Field {
+        uint32_t key_off;
+        uint32_t key_len;
+        uint32_t value_off;
+        uint32_t value_len;
+    };
+
+    const char *m_base{nullptr};
+    size_t m_count{0};
+    std::array<Field, MAX_FIELDS> m_fields{};
+};
+
+
+/**
+ * @brief HTTP 请求行和请求头解析器。
+        输入是从请求起始位置开始的接收缓冲区，解析结果都是相对于请求起始位置的偏移，
+        数据不完整时返回 AGAIN，缓冲区追加数据后从上次的位置继续解析，已解析的行不会重新扫描。
+        整个解析过程没有 substr，也没有为 key/value 分配 std::string。
+        行尾和 key 的查找由 find_char_in_ranges 批量完成，同时校验非法字符。
+ *
+ */
+class HttpRequestParser {
+public:
+    void reset() noexcept;
+
+    URIState parse_request_line(std::string_view buf) noexcept;
+    HeaderState parse_headers(std::string_view buf) noexcept;
+
+    [[nodiscard]] HttpMethod method() const noexcept { return m_method; }
+    [[nodiscard]] HttpVersion version() const noexcept { return m_version; }
+
+    // 去掉开头的 '/' 和 '?' 之后的查询参数，空路径返回空 string_view
+    [[nodiscard]] std::string_view path(std::string_view buf) const noexcept {
+        return buf.substr(m_path_off, m_path_len);
+    }
+
+    // 接收缓冲区追加数据后地址可能改变，每次访问时重新绑定
+    [[nodiscard]] const HttpHeaders &headers(std::string_view buf) noexcept {
+        m_headers.rebase(buf.data());
+        return m_headers;
+    }
+
+    // 请求行和请求头(含空行)的总长度，请求体从这里开始
+    [[nodiscard]] size_t header_length() const noexcept { return m_pos; }
+
+private:
+    static constexpr size_t LINE_INVALID = std::string_view::npos - 1;
+
+    // 从 m_scan_pos 开始查找行尾，找到时返回 '\n' 的位置，数据不完整返回 npos，
+    // 行内有非法控制字符返回 LINE_INVALID
+    size_t find_line_end(std::string_view buf) noexcept;
+
+    size_t m_pos{0};       // 下一行的起始位置
+    size_t m_scan_pos{0};  // 当前行已经扫描过的位置，数据不完整时避免重复扫描
+
+    HttpMethod m_method{HttpMethod::METHOD_GET};
+    HttpVersion m_version{HttpVersion::HTTP_11};
+    uint32_t m_path_off{0};
+    uint32_t m_path_len{0};
+
+    HttpHeaders m_headers;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+
+enum class RangeState {
+    RANGE_NONE = 1,           // 没有 Range 或者无法解析，按完整文件响应 (200)
+    RANGE_SATISFIABLE,        // 至少一个区间有效 (206)
+    RANGE_NOT_SATISFIABLE     // 语法正确但没有有效区间 (416)
+};
+
+
+struct ByteRange {
+    size_t offset;
+    size_t length;
+};
+
+
+/**
+ * @brief Range 请求头 "bytes=0-99, 200-, -500" 的解析结果 (RFC 7233)，按请求中的顺序保存。
+        区间数固定上限，保存在数组中，不做堆分配。
+        超过区间上限，或者区间总长度超过文件大小 (重叠区间放大响应) 时忽略 Range，按完整文件响应。
+ *
+ */
+class ByteRanges {
+public:
+    static constexpr size_t MAX_RANGES = 16;
+
+    RangeState parse(std::string_view value, size_t file_size) noexcept;
+
+    [[nodiscard]] size_t size() const noexcept { return m_count; }
+    [[nodiscard]] const ByteRange &operator[](size_t i) const noexcept { return m_ranges[i]; }
+
+private:
+    std::array<ByteRange, MAX_RANGES> m_ranges{};
+    size_t m_count{0};
+};
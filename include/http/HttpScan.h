@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+
+/**
+ * @brief 成对的闭区间字符集合 [lo0, hi0, lo1, hi1, ...]，最多 8 对。
+        bytes 固定 16 字节，SSE4.2 的 pcmpestri 可以直接加载；table 是标量实现使用的查找表。
+ *
+ */
+struct ScanRanges {
+    ScanRanges(const char *ranges, int ranges_size);
+
+    alignas(16) char bytes[16]{};
+    int size;  // 有效字节数，必须是偶数
+    bool table[256]{};
+};
+
+
+// 返回 [p, end) 中第一个落在 ranges 中的字符位置，没有找到时返回 end。
+// 启动时根据 CPU 选择 AVX2 / SSE4.2 / 标量实现，一次处理 32 / 16 字节。
+const char *find_char_in_ranges(const char *p, const char *end, const ScanRanges &ranges);
+
+// 当前使用的实现: "avx2", "sse4.2" 或 "scalar"
+const char *scan_backend_name();
+
+
+using ScanFunc = const char *(*)(const char *, const char *, const ScanRanges &);
+
+struct ScanBackend {
+    ScanFunc find;
+    const char *name;
+};
+
+// 当前 CPU 支持的全部实现，第一个是标量实现。各实现不区分输入长度，测试用来和标量实现对比结果
+std::vector<ScanBackend> scan_backends();
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+#include "Thread.h"
+#include "noncopyable.h"
+
+
+constexpr size_t PRECOMPRESS_MIN_SIZE = 256;                  // 更小的文件压缩后节省不了一个报文
+constexpr size_t PRECOMPRESS_MAX_SIZE = 64 * 1024 * 1024;     // 整个文件读到内存中压缩
+
+
+/**
+ * @brief 后台线程遍历一次静态文件目录，为可压缩类型的文件生成 .gz (zlib) 和 .br (brotli)。
+        已有且新鲜 (修改时间和原文件相同) 的压缩文件不重新生成。先写临时文件再 rename，
+        修改时间设置为原文件的修改时间，然后让 FileCache 中的条目失效，重新加载时使用新的压缩文件。
+        编译时没有找到 zlib / brotli 的编码不生成；zstd 只使用已有的 .zst 文件。
+ *
+ */
+class Precompressor : private Noncopyable {
+public:
+    explicit Precompressor(std::string root);
+
+    void start();
+
+    // 生成 path 缺失或过期的压缩文件，返回生成的个数
+    static int compress_file(const std::string &path);
+
+private:
+    void walk(const std::string &dir, int &compressed);
+    void thread_func();
+
+    std::string m_root;
+    Thread m_thread{[this]()->void {this->thread_func();}, "Precompress"};
+};
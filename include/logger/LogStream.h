@@ -4,6 +4,7 @@
 #include <cassert>
 #include <cstring>
 #include <string>
+#include <string_view>
 
 #include "noncopyable.h"
 
@@ -70,6 +71,7 @@ public:
     LogStream& operator<<(const unsigned char*);
 
     LogStream& operator<<(const std::string&);
+    LogStream& operator<<(std::string_view);
 
     LogStream& operator<<(short);
     LogStream& operator<<(unsigned short);
@@ -30,7 +30,7 @@ private:
         void print_format_time();
 
         int m_line;
-        std::string m_code_filename;
+        const char* m_code_filename;   // __FILE__ 是字符串字面量，不需要拷贝
 
         LogStream m_stream{};
     };
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <string_view>
+#include <sys/types.h>
+
+#include "MemoryPool.h"
+#include "noncopyable.h"
+
+
+/**
+ * @brief 网络接收缓冲区，连续存储，读写位置分开 (muduo Buffer 的布局)。
+        +-------------------+------------------+------------------+
+        | prependable bytes |  readable bytes  |  writable bytes  |
+        +-------------------+------------------+------------------+
+        0      <=      read_index   <=   write_index    <=     capacity
+        retrieve 只移动 read_index，是 O(1) 的；数据读完时两个位置回到开头。
+        存储块来自所属 loop 的 MemoryPool，没有数据时调用 shrink_if_empty 还给 MemoryPool，
+        空闲的 keep-alive 连接不占用缓冲区。
+ *
+ */
+class Buffer : private Noncopyable {
+public:
+    static constexpr size_t CHEAP_PREPEND = 8;
+    static constexpr size_t INITIAL_SIZE = 4096 - CHEAP_PREPEND;
+    static constexpr size_t EXTRA_READ_SIZE = 64 * 1024;   // read_fd 的栈上扩展空间
+
+    // pool 为 nullptr 时直接分配
+    explicit Buffer(MemoryPool *pool = nullptr) : m_pool(pool) {}
+    ~Buffer();
+
+    [[nodiscard]] size_t readable_bytes() const noexcept { return m_write_index - m_read_index; }
+    [[nodiscard]] size_t writable_bytes() const noexcept { return m_data != nullptr ? m_capacity - m_write_index : 0; }
+    [[nodiscard]] size_t prependable_bytes() const noexcept { return m_data != nullptr ? m_read_index : 0; }
+    [[nodiscard]] bool empty() const noexcept { return m_read_index == m_write_index; }
+
+    [[nodiscard]] const char *peek() const noexcept { return m_data != nullptr ? m_data + m_read_index : nullptr; }
+    // 追加数据后地址可能改变，不能跨 append/read_fd 保存
+    [[nodiscard]] std::string_view readable() const noexcept { return {peek(), readable_bytes()}; }
+
+    void retrieve(size_t n) noexcept {
+        assert(n <= readable_bytes());
+        if (n < readable_bytes()) {
+            m_read_index += n;
+        } else {
+            retrieve_all();
+        }
+    }
+    void retrieve_all() noexcept {
+        m_read_index = CHEAP_PREPEND;
+        m_write_index = CHEAP_PREPEND;
+    }
+
+    void append(std::string_view data);
+    void prepend(const void *data, size_t len) noexcept;
+
+    void ensure_writable(size_t len);
+    [[nodiscard]] char *begin_write() noexcept { return m_data + m_write_index; }
+    void has_written(size_t len) noexcept {
+        assert(len <= writable_bytes());
+        m_write_index += len;
+    }
+
+    // 一直读到 EAGAIN，或者读到的字节数达到 max_bytes，每次 readv 同时读入可写空间和栈上的 64 KB 扩展空间，
+    // 数据大多直接读到缓冲区中，不需要先读到临时数组再拷贝。
+    // 返回读到的字节数，出错返回 -1，对方关闭时 nodata 为 true
+    ssize_t read_fd(int fd, bool &nodata, size_t max_bytes = std::numeric_limits<size_t>::max());
+
+    // 没有未读数据时把存储块还给 MemoryPool
+    void shrink_if_empty() noexcept;
+
+private:
+    void make_space(size_t len);
+    void release_block() noexcept;
+
+    MemoryPool *m_pool;
+    char *m_data{nullptr};
+    size_t m_capacity{0};
+    size_t m_read_index{CHEAP_PREPEND};
+    size_t m_write_index{CHEAP_PREPEND};
+};
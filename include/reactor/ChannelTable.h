@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "utils/noncopyable.h"
+
+
+class Channel;
+class HttpData;
+
+
+/**
+ * @brief 按 fd 索引的 Channel/HttpData 表，每个 Poller 一个。
+        按页分配，只有用到的页才占用内存，内存随连接数增长，没有固定的 fd 上限。
+        页中的槽位全部 release 之后释放这一页，连接数回落之后内存也随之归还。
+        每个槽位有一个 generation，fd 每次注册时加一并放进 epoll_event，
+        fd 关闭后被新连接复用时，旧连接遗留的事件可以被识别出来。
+        释放页时记下其中最大的 generation，重新分配时从这个值继续，不会和遗留事件重复。
+ *
+ */
+class ChannelTable : private Noncopyable {
+public:
+    struct Slot {
+        std::shared_ptr<Channel> channel;
+        std::shared_ptr<HttpData> http_data;
+        uint32_t generation{0};
+        bool in_use{false};   // acquire 之后、release 之前
+    };
+
+    ChannelTable() = default;
+    ~ChannelTable() = default;
+
+    // 标记槽位正在使用，fd 所在的页不存在时分配
+    Slot &acquire(int fd);
+    // 槽位中的 channel 和 http_data 已经移走，页中没有正在使用的槽位时释放这一页。
+    // 之后不能再使用这个槽位的引用
+    void release(int fd);
+
+    // 不分配，页不存在时返回 nullptr
+    Slot *find(int fd) noexcept {
+        auto page = static_cast<size_t>(fd) >> PAGE_BITS;
+        if (fd < 0 || page >= m_pages.size() || !m_pages[page]) {
+            return nullptr;
+        }
+        return &m_pages[page]->slots[static_cast<size_t>(fd) & PAGE_MASK];
+    }
+
+private:
+    static constexpr size_t PAGE_BITS = 10;  // 每页 1024 个 fd
+    static constexpr size_t PAGE_SIZE = 1 << PAGE_BITS;
+    static constexpr size_t PAGE_MASK = PAGE_SIZE - 1;
+
+    struct Page {
+        std::array<Slot, PAGE_SIZE> slots;
+        size_t in_use{0};
+    };
+
+    std::vector<std::unique_ptr<Page>> m_pages;
+    std::vector<uint32_t> m_page_generation;   // 已释放的页中最大的 generation
+    // 保留一个空页，连接数在页的边界附近波动时不会反复分配和释放
+    std::unique_ptr<Page> m_spare_page;
+};
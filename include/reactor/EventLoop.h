@@ -1,13 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <vector>
 
 #include "Channel.h"
-#include "Epoll.h"
+#include "MemoryPool.h"
+#include "Poller.h"
 #include "logger/Logger.h"
+#include "threads/TaskQueue.h"
 #include "threads/CurrentThread.h"
 #include "threads/Thread.h"
 #include "utils/Utils.h"
@@ -27,7 +30,17 @@ public:
     void quit();
 
     // void run_in_loop(Functor&& cb);
-    void queue_in_loop(Functor&& cb);
+
+    // 任意线程投递任务，在本 EventLoop 线程中执行。不加锁，也不分配 std::function
+    // 同一线程投递的任务在本轮 do_pending_functors 中执行，不需要唤醒；
+    // 其他线程投递时，只有标志被消费者清除后的第一个生产者写 eventfd，其余的唤醒被合并
+    template <typename F>
+    void queue_in_loop(F&& cb) {
+        m_pending_tasks.push(std::forward<F>(cb));
+        if (!is_in_loop_thread() && !m_wakeup_pending.exchange(true, std::memory_order_acq_rel)) {
+            wakeup();
+        }
+    }
 
     [[nodiscard]] bool is_in_loop_thread() const { 
         PRINT("Check thread id, evtloop id " << m_thread_id << " run thread id " << CurrentThread::get_tid());
@@ -42,34 +55,67 @@ public:
     // };
 
     void remove_from_poller(std::shared_ptr<Channel> channel) {
-        m_poller->epoll_del(channel);
+        m_poller->remove_channel(channel);
     }
 
     void modify_poller(std::shared_ptr<Channel> channel, int timeout) {
-        m_poller->epoll_mod(channel, timeout);
+        m_poller->modify_channel(channel, timeout);
     }
 
     void add_to_poller(std::shared_ptr<Channel> channel, int timeout) {
-        m_poller->epoll_add(channel, timeout);
+        m_poller->add_channel(channel, timeout);
+    }
+
+    void add_acceptor_to_poller(std::shared_ptr<Channel> accept_channel) {
+        m_poller->add_acceptor(accept_channel);
+    }
+
+    // Poller 已经 accept 的连接，返回 false 时需要自己 accept
+    bool take_accepted(int listen_fd, std::vector<int> &conn_fds) {
+        return m_poller->take_accepted(listen_fd, conn_fds);
+    }
+
+    // 负载统计，由 HttpData 更新，分发连接的线程读取，只需要近似值
+    void add_connection() noexcept { m_load_connections.fetch_add(1, std::memory_order_relaxed); }
+    void remove_connection() noexcept { m_load_connections.fetch_sub(1, std::memory_order_relaxed); }
+    void add_pending_bytes(int64_t delta) noexcept { m_load_pending_bytes.fetch_add(delta, std::memory_order_relaxed); }
+
+    [[nodiscard]] int get_connection_count() const noexcept {
+        return m_load_connections.load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] int64_t get_pending_bytes() const noexcept {
+        return m_load_pending_bytes.load(std::memory_order_relaxed);
     }
 
+    // 本线程的连接对象、发送队列和接收缓冲区从这里分配
+    MemoryPool &get_memory_pool() noexcept { return m_memory_pool; }
+
 private:
     bool m_is_looping{false};
     bool m_is_quit{false};
     bool m_is_calling_pending_functors{false};
     bool m_is_event_handling{false};
 
-    int m_wakeup_fd;  // 每个线程一个 wakeup fd，用于唤醒线程处理对应线程的 m_pending_functors
-
-    // 这个锁，是对本线程内任务队列的读写锁
-    mutable Mutex m_mutex;
+    int m_wakeup_fd;  // 每个线程一个 wakeup fd，用于唤醒线程处理对应线程的 m_pending_tasks
     
     const pid_t m_thread_id;
-    
-    std::shared_ptr<Epoll> m_poller;
+
+    // 在 m_poller 之前构造，Poller 中的 HttpData 析构时归还内存块
+    MemoryPool m_memory_pool;
+    std::unique_ptr<Poller> m_poller;
     std::shared_ptr<Channel> m_wakeup_channel;
 
-    std::vector<Functor> m_pending_functors;
+    // 其他线程投递的任务，无锁队列
+    TaskQueue m_pending_tasks;
+    // 已经写过 eventfd、消费者还没有处理时为 true
+    std::atomic<bool> m_wakeup_pending{false};
+
+    // 分配到本线程的连接数，和已排队未发送的响应字节数
+    alignas(64) std::atomic<int> m_load_connections{0};
+    std::atomic<int64_t> m_load_pending_bytes{0};
+
+    // epoll_wait 返回的就绪 Channel，每轮循环复用，不再重新分配
+    std::vector<Channel*> m_active_channels;
 
     void wakeup();
     void handle_read();
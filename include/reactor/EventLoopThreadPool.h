@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -8,6 +9,16 @@
 #include "utils/noncopyable.h"
 
 
+// 新连接分配到哪个 EventLoop，配置文件中的 DISPATCH
+enum class DispatchPolicy {
+    ROUND_ROBIN = 0,  // round_robin
+    LEAST_CONN,       // least_conn: 连接数最少的
+    P2C_CONN,         // p2c_conn: 随机选两个，取连接数少的
+    P2C_BYTES,        // p2c_bytes: 随机选两个，取未发送字节数少的
+    IP_HASH           // ip_hash: 同一个客户端 IP 总是分配到同一个线程
+};
+
+
 class EventLoopThreadPool : Noncopyable {
 public:
     EventLoopThreadPool(EventLoop *base_loop, int num_threads);
@@ -16,11 +27,28 @@ public:
     }
 
     void start();
-    EventLoop* get_next_loop();
+    // client_ip 只在 IP_HASH 时使用
+    EventLoop* get_next_loop(uint32_t client_ip = 0);
+
+    void set_dispatch_policy(DispatchPolicy policy) noexcept { m_policy = policy; }
+    [[nodiscard]] DispatchPolicy get_dispatch_policy() const noexcept { return m_policy; }
+    // 无法识别的名字按 round_robin 处理
+    static DispatchPolicy parse_dispatch_policy(const char *name);
+    // 所有工作线程的 EventLoop，start 之后才有效
+    const std::vector<EventLoop*> &get_all_loops() const noexcept { return m_evtloops; }
 
 private:
+    size_t next_round_robin_index();
+    size_t random_index();
+    // 随机选两个不同的线程，load 返回值小的优先
+    template <typename Load>
+    size_t power_of_two_choices(Load load);
+
     EventLoop* m_base_loop;
 
+    DispatchPolicy m_policy{DispatchPolicy::ROUND_ROBIN};
+    uint32_t m_random_state{0x9E3779B9};  // 只在 base loop 线程中使用
+
     bool m_started{false};
     int m_next_idx{0};
     int m_num_threads;
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+
+
+constexpr size_t MEMORYPOOL_MIN_BLOCK = 64;
+constexpr size_t MEMORYPOOL_CLASSES = 15;                          // 64 B ~ 1 MB
+constexpr size_t MEMORYPOOL_MAX_CACHED_BYTES = 4 * 1024 * 1024;    // 每个 loop 最多缓存的空闲块
+
+
+/**
+ * @brief 每个 EventLoop 一个的内存块分配器，按 2 的幂分级的空闲链表。
+        连接对象 (HttpData 和 shared_ptr 控制块)、发送队列的节点和接收缓冲区都从这里分配，
+        稳定的负载下不再调用全局的 operator new。
+        空闲链表只在创建它的 loop 线程中使用，不加锁；每个块都是单独分配的，
+        在其他线程释放或者超过缓存上限时直接 operator delete。
+ *
+ */
+class MemoryPool : private Noncopyable {
+public:
+    MemoryPool();
+    ~MemoryPool();
+
+    // size 向上取整到级别大小，实际大小写回 size
+    void *allocate(size_t &size);
+    void deallocate(void *block, size_t size) noexcept;
+
+    [[nodiscard]] size_t cached_bytes() const noexcept { return m_cached_bytes; }
+
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    static size_t class_index(size_t size) noexcept;
+    [[nodiscard]] bool in_owner_thread() const noexcept;
+
+    const pid_t m_owner_tid;
+    std::array<FreeBlock *, MEMORYPOOL_CLASSES> m_free{};
+    size_t m_cached_bytes{0};
+};
+
+
+// 从 MemoryPool 分配的 STL 分配器，用于 allocate_shared 和容器
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(MemoryPool *pool) noexcept : m_pool(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) noexcept : m_pool(other.pool()) {}
+
+    T *allocate(size_t n) {
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned type");
+        size_t size = n * sizeof(T);
+        return static_cast<T *>(m_pool->allocate(size));
+    }
+    void deallocate(T *p, size_t n) noexcept {
+        m_pool->deallocate(p, n * sizeof(T));
+    }
+
+    [[nodiscard]] MemoryPool *pool() const noexcept { return m_pool; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &other) const noexcept { return m_pool == other.pool(); }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &other) const noexcept { return m_pool != other.pool(); }
+
+private:
+    MemoryPool *m_pool;
+};
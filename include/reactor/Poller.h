@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <sys/epoll.h>
+#include <vector>
+
+#include "Channel.h"
+#include "ChannelTable.h"
+#include "HttpData.h"
+#include "Timer.h"
+#include "noncopyable.h"
+
+
+// 配置文件中的 POLLER
+enum class PollerBackend {
+    EPOLL = 0,   // epoll
+    IO_URING     // io_uring
+};
+
+
+/**
+ * @brief I/O 多路复用的公共部分: fd 到 Channel/HttpData 的映射、定时器、延迟释放。
+        后端只负责注册事件和等待，就绪事件统一以 epoll_event 的形式写入 m_events_buf，
+        data.u64 是 fd 和 generation，events 是就绪的事件。
+ *
+ */
+class Poller : private Noncopyable {
+public:
+    virtual ~Poller() = default;
+
+    // 按 set_default_backend 创建，io_uring 不可用时使用 epoll
+    static std::unique_ptr<Poller> new_poller();
+    // 在创建 EventLoop 之前设置
+    static void set_default_backend(PollerBackend backend) noexcept { s_default_backend = backend; }
+    // 无法识别的名字按 epoll 处理
+    static PollerBackend parse_backend(const char *name);
+
+    [[nodiscard]] virtual const char *backend_name() const noexcept = 0;
+
+    // event management
+    void add_channel(std::shared_ptr<Channel> req_channel, int timeout);
+    void modify_channel(std::shared_ptr<Channel> req_channel, int timeout);
+    void remove_channel(std::shared_ptr<Channel> req_channel);
+
+    // 监听 socket 的 Channel。后端支持时由内核直接 accept (io_uring multishot accept)，
+    // 得到的连接通过 take_accepted 取出；否则和 add_channel 一样只等待可读
+    void add_acceptor(std::shared_ptr<Channel> accept_channel);
+    // 后端已经 accept 的连接追加到 conn_fds。返回 true 表示 listen_fd 由后端 accept，
+    // 返回 false 时调用者还需要自己 accept
+    virtual bool take_accepted(int /*listen_fd*/, std::vector<int> & /*conn_fds*/) { return false; }
+
+    void add_timer(std::shared_ptr<Channel> req_channel, int timeout);
+    void handle_expired();
+
+    // 就绪的 Channel 写入调用者持有的 active_channels，容器在每轮循环之间复用。
+    // 裸指针的有效性由 release_closed 保证: 本轮删除的 Channel 延迟到事件处理完之后才释放
+    // 最多等到最近的定时器到期，超时返回时 active_channels 为空，由 EventLoop 处理到期的定时器
+    void get_active_events(std::vector<Channel*> &active_channels);
+    void release_closed();
+
+protected:
+    Poller();
+
+    // 后端接口，data 是 fd 和 generation，失败返回 false
+    virtual bool backend_add(int fd, uint32_t events, uint64_t data) = 0;
+    // old_data 是修改前注册的 data
+    virtual bool backend_mod(int fd, uint32_t events, uint64_t data, uint64_t old_data) = 0;
+    virtual bool backend_del(int fd, uint32_t events, uint64_t data) = 0;
+    // 由后端 accept 监听 socket 的连接，不支持时返回 false
+    virtual bool backend_add_acceptor(int /*fd*/, uint64_t /*data*/) { return false; }
+    // 最多等待 timeout ms，就绪事件写入 m_events_buf，返回个数，出错返回 -1
+    virtual int backend_wait(int timeout) = 0;
+
+    std::vector<epoll_event> m_events_buf;
+
+private:
+    void collect_active_channels(int event_count, std::vector<Channel*> &active_channels);
+    void release_slot(int fd, ChannelTable::Slot &slot);
+
+    static PollerBackend s_default_backend;
+
+    // fd to Channel / HttpData management
+    ChannelTable m_channels;
+
+    // 本轮循环中删除的连接，在 release_closed 中统一释放
+    std::vector<std::shared_ptr<Channel>> m_closed_channels;
+    std::vector<std::shared_ptr<HttpData>> m_closed_httpdata;
+
+    // timer management
+    TimerManager m_timer_manager;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <vector>
+
+#include "Poller.h"
+
+
+/**
+ * @brief io_uring 后端，直接使用系统调用 (不依赖 liburing)。
+        用 IORING_OP_POLL_ADD 做就绪通知: 带 EPOLLONESHOT 的 Channel 使用单次 poll，其余使用 multishot poll。
+        注册、修改、删除只是在 SQ 中写入 SQE，在下一次等待时和等待合并成一次 io_uring_enter，
+        EPOLLONESHOT 的重新注册不再需要单独的 epoll_ctl。
+        监听 socket 使用 multishot accept (IORING_OP_ACCEPT + IORING_ACCEPT_MULTISHOT)，一次提交之后
+        每个新连接产生一个完成事件，连接的 fd 在 take_accepted 中取出，不再需要每个连接一次 accept4。
+        内核不支持时 (5.19 之前) 退回到 poll 就绪通知，由调用者 accept。
+        连接上的读写仍然由 HttpData 在就绪之后直接调用 read/write/sendfile。
+ *
+ */
+class UringPoller : public Poller {
+public:
+    UringPoller();
+    ~UringPoller() override;
+
+    // 内核不支持或者被禁用时为 false
+    [[nodiscard]] bool is_valid() const noexcept { return m_ring_fd >= 0; }
+    [[nodiscard]] const char *backend_name() const noexcept override { return "io_uring"; }
+
+    bool take_accepted(int listen_fd, std::vector<int> &conn_fds) override;
+
+protected:
+    bool backend_add(int fd, uint32_t events, uint64_t data) override;
+    bool backend_mod(int fd, uint32_t events, uint64_t data, uint64_t old_data) override;
+    bool backend_del(int fd, uint32_t events, uint64_t data) override;
+    int backend_wait(int timeout) override;
+    bool backend_add_acceptor(int fd, uint64_t data) override;
+
+private:
+    // fd 上未完成的 poll 或者 multishot accept 请求，data 为 0 表示没有
+    struct PollState {
+        uint64_t data{0};
+        uint32_t events{0};
+        bool accept{false};
+        std::vector<int> accepted;   // 已经 accept、还没有被 take_accepted 取走的连接
+    };
+
+    bool setup(unsigned entries);
+    void teardown();
+
+    PollState &state_of(int fd);
+    void arm_poll(int fd, uint32_t events, uint64_t data);
+    void arm_accept(int fd, uint64_t data);
+    // 处理 multishot accept 的完成事件，需要通知监听 socket 的 Channel 时返回 true
+    bool complete_accept(int fd, uint64_t data, const struct io_uring_cqe &cqe);
+    void cancel_poll(PollState &state);
+
+    // SQ 满时先提交已有的 SQE
+    struct io_uring_sqe *get_sqe();
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags, int timeout);
+    int reap_completions();
+
+    int m_ring_fd{-1};
+    uint32_t m_features{0};
+
+    // SQ ring
+    void *m_sq_ring{nullptr};
+    size_t m_sq_ring_size{0};
+    unsigned *m_sq_head{nullptr};
+    unsigned *m_sq_tail{nullptr};
+    unsigned m_sq_mask{0};
+    unsigned m_sq_entries{0};
+    unsigned m_sq_local_tail{0};   // 已写入、还没有提交给内核的 SQE 到这里为止
+    struct io_uring_sqe *m_sqes{nullptr};
+    size_t m_sqes_size{0};
+
+    // CQ ring，内核支持 IORING_FEAT_SINGLE_MMAP 时和 SQ ring 是同一块映射
+    void *m_cq_ring{nullptr};
+    size_t m_cq_ring_size{0};
+    unsigned *m_cq_head{nullptr};
+    unsigned *m_cq_tail{nullptr};
+    unsigned m_cq_mask{0};
+    struct io_uring_cqe *m_cqes{nullptr};
+
+    std::vector<PollState> m_poll_states;   // 按 fd 索引
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "Channel.h"
 #include "EventLoop.h"
@@ -9,24 +10,33 @@
 
 class Server {
 public:
-    Server(EventLoop* loop, int num_threads, int port);
+    // reuse_port 为 true 时，每个 EventLoop 线程在自己的 SO_REUSEPORT socket 上 accept，主线程不再接受连接
+    Server(EventLoop* loop, int num_threads, int port, bool reuse_port = false);
     ~Server() = default;
 
     EventLoop* get_loop() { return m_main_loop; }
+    // 工作线程的 EventLoop，start 之后有效
+    const std::vector<EventLoop*>& get_loops() const { return m_evt_loop_th_pool->get_all_loops(); }
+    // SO_REUSEPORT 模式下由内核分配连接，不使用分发策略
+    void set_dispatch_policy(DispatchPolicy policy) { m_evt_loop_th_pool->set_dispatch_policy(policy); }
     void start();
     void handle_available_connfd();
     void handle_connect();
 
 private:
+    void start_reuseport_acceptors();
+    // 在 accept_channel 所属的线程中调用
+    void accept_connections(EventLoop* accept_loop, Channel& accept_channel);
+
     bool m_started{false};
+    bool m_reuse_port;
 
     EventLoop* m_main_loop;
     int m_num_threads;
     int m_port;
     int m_listen_fd;
 
-    static const int MAXFDS = 100'000;
-
     std::unique_ptr<EventLoopThreadPool> m_evt_loop_th_pool;
     std::shared_ptr<Channel> m_accept_channel;
+    std::vector<std::shared_ptr<Channel>> m_reuseport_channels;   // 每个工作线程一个
 };
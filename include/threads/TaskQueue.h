@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "noncopyable.h"
+
+
+// MpscQueue 的侵入式节点
+struct MpscNode {
+    std::atomic<MpscNode *> m_next{nullptr};
+};
+
+
+/**
+ * @brief Dmitry Vyukov 的侵入式无锁多生产者单消费者队列。
+        push 可以在任意线程调用，只有一次 exchange 和一次 store，不会等待；
+        pop 只能在消费者线程调用，生产者正处在 exchange 和 store 之间时返回 nullptr，
+        那个生产者随后会发出自己的唤醒，节点不会丢失。
+ *
+ */
+class MpscQueue : private Noncopyable {
+public:
+    MpscQueue() : m_head(&m_stub), m_tail(&m_stub) {}
+
+    void push(MpscNode *node) noexcept {
+        node->m_next.store(nullptr, std::memory_order_relaxed);
+        MpscNode *prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->m_next.store(node, std::memory_order_release);
+    }
+
+    MpscNode *pop() noexcept;
+
+private:
+    alignas(64) std::atomic<MpscNode *> m_head;   // 生产者一端
+    alignas(64) MpscNode *m_tail;                 // 消费者一端
+    MpscNode m_stub;
+};
+
+
+// 队列中的任务，可调用对象不超过 INLINE_SIZE 时直接构造在节点里，否则放在堆上
+class TaskNode : public MpscNode {
+public:
+    static constexpr size_t INLINE_SIZE = 64;
+
+    template <typename F>
+    void emplace(F &&func) {
+        using T = std::decay_t<F>;
+        if constexpr (sizeof(T) <= INLINE_SIZE && alignof(T) <= alignof(std::max_align_t)) {
+            new (m_storage) T(std::forward<F>(func));
+            m_run = [](TaskNode *node) {
+                T *callable = std::launder(reinterpret_cast<T *>(node->m_storage));
+                (*callable)();
+                callable->~T();
+            };
+            m_discard = [](TaskNode *node) { std::launder(reinterpret_cast<T *>(node->m_storage))->~T(); };
+        } else {
+            new (m_storage) T *(new T(std::forward<F>(func)));
+            m_run = [](TaskNode *node) {
+                T *callable = *std::launder(reinterpret_cast<T **>(node->m_storage));
+                (*callable)();
+                delete callable;
+            };
+            m_discard = [](TaskNode *node) { delete *std::launder(reinterpret_cast<T **>(node->m_storage)); };
+        }
+    }
+
+    // 执行并析构可调用对象，节点可以再次 emplace
+    void run() { m_run(this); }
+    // 不执行，只析构
+    void discard() noexcept { m_discard(this); }
+
+    TaskNode *m_free_next{nullptr};   // 空闲链表
+
+private:
+    alignas(std::max_align_t) unsigned char m_storage[INLINE_SIZE];
+    void (*m_run)(TaskNode *){nullptr};
+    void (*m_discard)(TaskNode *){nullptr};
+};
+
+
+/**
+ * @brief EventLoop 的跨线程任务队列: MpscQueue + 节点池，投递任务不加锁，也不分配 std::function。
+        执行完的节点由消费者压回本队列的空闲栈 (CAS)，生产者用 exchange 一次取走整个空闲栈
+        放进自己线程的缓存。空闲栈只有一个压入者，取出是整体取走，不存在 ABA 问题。
+ *
+ */
+class TaskQueue : private Noncopyable {
+public:
+    TaskQueue() = default;
+    ~TaskQueue();
+
+    // 任意线程
+    template <typename F>
+    void push(F &&func) {
+        TaskNode *node = allocate();
+        node->emplace(std::forward<F>(func));
+        m_queue.push(node);
+    }
+
+    // 只在消费者线程调用，执行队列中的全部任务，返回执行的个数
+    size_t run_all();
+
+private:
+    TaskNode *allocate();
+    void recycle(TaskNode *node) noexcept;
+
+    MpscQueue m_queue;
+    alignas(64) std::atomic<TaskNode *> m_free{nullptr};
+};
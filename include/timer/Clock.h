@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+
+
+/**
+ * @brief 线程内缓存的时钟。EventLoop 每轮循环调用一次 update()，
+        同一轮中的定时器、日志和 HTTP Date 头都读取缓存，不再重复调用 clock_gettime / localtime。
+        没有调用过 update() 的线程 (主线程、日志线程) 每次读取时都会重新取时间。
+ *
+ */
+class Clock {
+public:
+    Clock() = delete;
+
+    // 刷新当前线程的缓存，并开始使用缓存
+    static void update();
+    // 把当前线程的 now_ms() 固定为 ms，直到下一次 update()。测试中用来模拟 tick
+    static void set_now_ms(uint64_t ms);
+
+    // CLOCK_MONOTONIC，单位 ms，不受系统时间调整的影响，定时器使用
+    static uint64_t now_ms();
+    // 墙上时间，单位 s
+    static time_t wall_seconds();
+
+    // RFC 7231 格式，如 "Sun, 06 Nov 1994 08:49:37 GMT"，每秒生成一次
+    static std::string_view http_date();
+    // 任意时间的 RFC 7231 格式，写入 buf，返回长度
+    static size_t format_http_date(time_t seconds, char *buf, size_t len);
+    // 接受 IMF-fixdate、RFC 850 和 asctime 三种 HTTP-date，格式错误返回 false
+    static bool parse_http_date(std::string_view value, time_t &seconds);
+    // 本地时间 "%Y-%m-%d %H:%M:%S"，每秒生成一次
+    static std::string_view log_time();
+};
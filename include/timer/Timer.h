@@ -1,65 +1,95 @@
 #pragma once
 
-#include <deque>
-#include <memory>
-#include <queue>
-#include <sys/time.h>
-#include <unistd.h>
-
-#include "HttpData.h"
-#include "Mutex.h"
+#include <cstdint>
+#include <functional>
+
 #include "noncopyable.h"
 
 
-class HttpData;
+class TimerManager;
+
+// 双向循环链表的指针部分，时间轮的槽位只需要这部分作为哨兵
+struct TimerLink {
+    TimerLink *m_prev{nullptr};
+    TimerLink *m_next{nullptr};
+};
+
 
-// For priority queue.
-class TimerNode : public std::enable_shared_from_this<TimerNode> {
+// 侵入式定时器节点，嵌入在 HttpData 中，随连接一起创建和销毁。
+// 重新设置超时只是把节点从一个槽位移到另一个槽位，不再分配内存
+class TimerNode : private TimerLink, private Noncopyable {
 public:
-    TimerNode(std::shared_ptr<HttpData> request_data_sp, int timeout);
-    ~TimerNode();
+    using Callback = std::function<void()>;
 
-    TimerNode(const TimerNode &tn);
+    TimerNode() = default;
+    ~TimerNode() { cancel(); }
 
-    // std::shared_ptr<TimerNode> get_shared() {
-    //     return shared_from_this();
-    // }
+    void set_callback(Callback cb) { m_callback = std::move(cb); }
 
-    bool is_valid();
+    // 从时间轮中摘除，未挂在时间轮上时什么也不做
+    void cancel() noexcept;
 
-    void update(int timeout);
-    // clear m_http_data_sp, set node waiting to be deleted.
-    void invalidate_timer();
-    
-    void set_deleted() noexcept { m_deleted = true; }
-    [[nodiscard]] bool is_deleted() const noexcept { return m_deleted; }
-    [[nodiscard]] size_t get_expire_time() const noexcept { return m_expire_time; }
+    [[nodiscard]] bool is_linked() const noexcept { return m_next != nullptr; }
+    [[nodiscard]] uint64_t get_expire_time() const noexcept { return m_expire_time; }
 
 private:
-    bool m_deleted {false};  // target
-    size_t m_expire_time;   // time that timer is expired
-    std::shared_ptr<HttpData> m_http_data_sp;
-};
+    friend class TimerManager;
 
+    TimerManager *m_manager{nullptr};
 
-struct TimerCmp {
-    bool operator()(std::shared_ptr<TimerNode> &a, std::shared_ptr<TimerNode> &b) const noexcept {
-        return a->get_expire_time() > b->get_expire_time();
-    }
+    uint64_t m_expire_time{0};   // 单位 ms，Clock::now_ms()
+    Callback m_callback;
 };
 
 
-class TimerManager {
+/**
+ * @brief 分层时间轮，参考 Linux 内核 2.6 的 timer wheel，每个 EventLoop 一个，只在 loop 线程中使用。
+        精度 1ms，tv1 有 256 个槽，tv2 ~ tv4 各 64 个槽，最长约 18.6 小时，超过的按最长处理。
+        添加、删除、移动定时器都是 O(1)；每个 tick 只处理 tv1 的一个槽，
+        tv1 转完一圈时把 tv2 的一个槽重新分配到 tv1 (cascade)，以此类推。
+ *
+ */
+class TimerManager : private Noncopyable {
 public:
-    TimerManager() = default;
-    ~TimerManager() = default;
+    TimerManager();
+    ~TimerManager();
 
-    void add_timer(const std::shared_ptr<HttpData>& request_data_sp, int timeout);
+    // 已经挂在时间轮上的节点会先摘除，再按新的超时时间挂上
+    void add_timer(TimerNode &node, int timeout);
+    // 处理到当前时间为止到期的定时器，回调中可以添加或取消定时器
     void handle_expired_event();
+    // 距离下一次需要处理定时器的毫秒数，不超过 max_timeout；没有定时器时返回 max_timeout
+    int next_timeout(int max_timeout) const noexcept;
 
-private:
-    using TimerNodeSP = std::shared_ptr<TimerNode>;
+    [[nodiscard]] size_t size() const noexcept { return m_count; }
 
-    std::priority_queue<TimerNodeSP, std::deque<TimerNodeSP>, TimerCmp> m_timer_queue;
+private:
+    friend class TimerNode;
+
+    static constexpr int TVR_BITS = 8;
+    static constexpr int TVN_BITS = 6;
+    static constexpr int TVR_SIZE = 1 << TVR_BITS;
+    static constexpr int TVN_SIZE = 1 << TVN_BITS;
+    static constexpr uint64_t TVR_MASK = TVR_SIZE - 1;
+    static constexpr uint64_t TVN_MASK = TVN_SIZE - 1;
+    static constexpr int TVN_LEVELS = 3;
+    static constexpr uint64_t MAX_TIMEOUT = (1ULL << (TVR_BITS + TVN_LEVELS * TVN_BITS)) - 1;
+
+    // 槽位是带哨兵的双向循环链表
+    static void list_init(TimerLink &head) noexcept;
+    static void list_add_tail(TimerLink &head, TimerLink &node) noexcept;
+    static void list_del(TimerLink &node) noexcept;
+    static void list_splice(TimerLink &from, TimerLink &to) noexcept;
+    static TimerNode *to_node(TimerLink *link) noexcept { return static_cast<TimerNode *>(link); }
+
+    void internal_add(TimerNode &node) noexcept;
+    int cascade(int level, int index) noexcept;
+    void run_timers(uint64_t now);
+    uint64_t next_expire_time() const noexcept;
+
+    uint64_t m_current;   // 下一个待处理的 tick
+    size_t m_count{0};
+
+    TimerLink m_tv1[TVR_SIZE];
+    TimerLink m_tvn[TVN_LEVELS][TVN_SIZE];
 };
-
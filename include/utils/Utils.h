@@ -2,6 +2,8 @@
 
 #include <cstdlib>
 #include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 ssize_t readn(int fd, void *buff, size_t n);
 ssize_t read_utill_nodata(int fd, std::string &buff, bool &nodata);
@@ -10,6 +12,10 @@ ssize_t read_utill_nodata_nflag(int fd, std::string &buff);
 ssize_t writen(int fd, void *buff, size_t n);
 ssize_t writen(int fd, std::string &buff);
 
+ssize_t sendfilen(int out_fd, int in_fd, off_t &offset, size_t &remain);
+// 发送 iov 中的数据直到发送完或者发送缓冲区满，more 为 true 时带 MSG_MORE。iov 会被修改
+ssize_t sendmsgn(int fd, struct iovec *iov, int iovcnt, bool more);
+
 void handle_sigpipe();
 
 int set_socket_nonblock(int fd);
@@ -18,4 +24,5 @@ void set_socket_nolinger(int fd);
 
 void shutdown_WR(int fd);
 
-int socket_bind_listen(int port);
\ No newline at end of file
+// reuse_port 为 true 时设置 SO_REUSEPORT，多个线程各自监听同一个端口，由内核分配连接
+int socket_bind_listen(int port, bool reuse_port = false);
\ No newline at end of file
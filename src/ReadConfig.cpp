@@ -88,6 +88,13 @@ extern "C" {
         return NULL;
     }
 
+    // 可选配置项，未配置时返回默认值
+    static int scan_config_int(const char *keyword, int default_value) {
+        char *value = scan_configfile(keyword);
+        if (value == NULL) { return default_value; }
+        return strtol(value, NULL, 10);
+    }
+
     int get_nthread() {
         return strtol(scan_configfile("THREADNUMBER"), NULL, 10);
     }
@@ -99,4 +106,81 @@ extern "C" {
     void get_logfile(char *log_filename) {
         strcpy(log_filename, scan_configfile("LOGFILE"));
     }
+
+    int get_filecache_size() {
+        return scan_config_int("FILECACHE_SIZE", 1024);
+    }
+
+    int get_filecache_revalidate_ms() {
+        return scan_config_int("FILECACHE_REVALIDATE_MS", 2000);
+    }
+
+    // 非 0 时每个 EventLoop 线程使用自己的 SO_REUSEPORT 监听 socket
+    int get_reuseport() {
+        return scan_config_int("REUSEPORT", 0);
+    }
+
+    // 新连接的分发策略，未配置时为 round_robin
+    void get_dispatch_policy(char *policy_name, int len) {
+        char *value = scan_configfile("DISPATCH");
+        snprintf(policy_name, len, "%s", value == NULL ? "round_robin" : value);
+    }
+
+    // I/O 多路复用后端 epoll | io_uring，未配置时为 epoll
+    void get_poller_backend(char *backend_name, int len) {
+        char *value = scan_configfile("POLLER");
+        snprintf(backend_name, len, "%s", value == NULL ? "epoll" : value);
+    }
+
+    // 默认 1: 连接使用 EPOLLONESHOT，每次事件之后重新注册。
+    // 0 需要显式配置: 使用持续注册的边沿触发，省去重新注册的 epoll_ctl
+    int get_oneshot() {
+        return scan_config_int("ONESHOT", 1);
+    }
+
+    // 非 0 时启动后在后台为静态文件生成 .gz/.br 预压缩版本
+    int get_precompress() {
+        return scan_config_int("PRECOMPRESS", 0);
+    }
+
+    // 非 0 时没有预压缩版本的文本文件在请求时 gzip 压缩
+    int get_gzip() {
+        return scan_config_int("GZIP", 1);
+    }
+
+    // 动态压缩结果的缓存大小，单位 MB
+    int get_gzip_cache_size() {
+        return scan_config_int("GZIP_CACHE_SIZE", 32);
+    }
+
+    // 每个 loop 线程每秒最多压缩的字节数，单位 KB
+    int get_gzip_budget() {
+        return scan_config_int("GZIP_BUDGET", 16384);
+    }
+
+    // 非 0 时注册 /server-status 状态页，页面公开连接数和缓存统计，默认关闭
+    int get_server_status() {
+        return scan_config_int("SERVER_STATUS", 0);
+    }
+
+    // 非 0 时注册 /upload 上传示例，接收任意客户端的请求体，默认关闭
+    int get_upload() {
+        return scan_config_int("UPLOAD", 0);
+    }
+
+    // 请求体的最大大小，单位 KB
+    int get_body_max_size() {
+        return scan_config_int("BODY_MAX_SIZE", 10240);
+    }
+
+    // 请求体超过这个大小后写入临时文件，单位 KB
+    int get_body_spool_threshold() {
+        return scan_config_int("BODY_SPOOL_THRESHOLD", 64);
+    }
+
+    // 请求体临时文件所在的目录，未配置时为 /tmp
+    void get_body_spool_dir(char *dir, int len) {
+        char *value = scan_configfile("BODY_SPOOL_DIR");
+        snprintf(dir, len, "%s", value == NULL ? "/tmp" : value);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "BodySpool.h"
+#include "Utils.h"
+
+
+BodySpool::BodySpool(size_t threshold, std::string dir)
+    : m_threshold(threshold), m_dir(std::move(dir)) {}
+
+
+BodySpool::~BodySpool() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+
+bool BodySpool::open_spool_file() {
+    m_fd = open(m_dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (m_fd < 0) {
+        perror("BodySpool open O_TMPFILE failed.");
+        return false;
+    }
+
+    // 内存中的数据先写入文件，之后的数据直接追加
+    ssize_t ret = writen(m_fd, m_memory.data(), m_memory.size());
+    std::string().swap(m_memory);
+    return ret >= 0;
+}
+
+
+bool BodySpool::append(std::string_view data) {
+    m_size += data.size();
+    if (m_fd < 0) {
+        if (m_size <= m_threshold) {
+            m_memory.append(data);
+            return true;
+        }
+        if (!open_spool_file()) {
+            return false;
+        }
+    }
+    return writen(m_fd, const_cast<char *>(data.data()), data.size()) == static_cast<ssize_t>(data.size());
+}
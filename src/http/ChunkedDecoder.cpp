@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <limits>
+
+#include "ChunkedDecoder.h"
+
+
+namespace {
+    int hex_value(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+}  // namespace
+
+
+void ChunkedDecoder::reset() noexcept {
+    m_state = State::SIZE_LINE;
+    m_chunk_remain = 0;
+    m_trailer_bytes = 0;
+}
+
+
+bool ChunkedDecoder::parse_size_line(std::string_view line, size_t &size) noexcept {
+    if (line.empty() || line.back() != '\r') {
+        return false;
+    }
+    line.remove_suffix(1);
+
+    size = 0;
+    size_t pos = 0;
+    for (; pos < line.size() && hex_value(line[pos]) >= 0; ++pos) {
+        if (size > (std::numeric_limits<size_t>::max() >> 4)) {
+            return false;
+        }
+        size = (size << 4) | static_cast<size_t>(hex_value(line[pos]));
+    }
+    if (pos == 0) {
+        return false;
+    }
+
+    // 长度之后只能是空白和 chunk 扩展
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) {
+        ++pos;
+    }
+    return pos == line.size() || line[pos] == ';';
+}
+
+
+size_t ChunkedDecoder::decode(std::string_view input, size_t max_data, std::string_view &data) noexcept {
+    data = {};
+    size_t consumed = 0;
+
+    while (true) {
+        std::string_view rest = input.substr(consumed);
+        switch (m_state) {
+            case State::SIZE_LINE: {
+                size_t lf_pos = rest.find('\n');
+                if (lf_pos == std::string_view::npos) {
+                    if (rest.size() > CHUNKED_MAX_LINE) {
+                        m_state = State::ERROR;
+                    }
+                    return consumed;
+                }
+                size_t size = 0;
+                if (lf_pos > CHUNKED_MAX_LINE || !parse_size_line(rest.substr(0, lf_pos), size)) {
+                    m_state = State::ERROR;
+                    return consumed;
+                }
+                consumed += lf_pos + 1;
+                m_chunk_remain = size;
+                m_state = size == 0 ? State::TRAILER : State::DATA;
+                break;
+            }
+            case State::DATA: {
+                if (rest.empty() || max_data == 0) {
+                    return consumed;
+                }
+                size_t n = std::min({rest.size(), m_chunk_remain, max_data});
+                data = rest.substr(0, n);
+                consumed += n;
+                m_chunk_remain -= n;
+                if (m_chunk_remain == 0) {
+                    m_state = State::DATA_CRLF;
+                }
+                return consumed;
+            }
+            case State::DATA_CRLF: {
+                if (rest.size() < 2) {
+                    return consumed;
+                }
+                if (rest[0] != '\r' || rest[1] != '\n') {
+                    m_state = State::ERROR;
+                    return consumed;
+                }
+                consumed += 2;
+                m_state = State::SIZE_LINE;
+                break;
+            }
+            case State::TRAILER: {
+                // trailer 行一直到空行
+                size_t lf_pos = rest.find('\n');
+                size_t line_bytes = lf_pos == std::string_view::npos ? rest.size() : lf_pos + 1;
+                if (m_trailer_bytes + line_bytes > CHUNKED_MAX_TRAILER) {
+                    m_state = State::ERROR;
+                    return consumed;
+                }
+                if (lf_pos == std::string_view::npos) {
+                    return consumed;
+                }
+                consumed += line_bytes;
+                m_trailer_bytes += line_bytes;
+                if (lf_pos == 1 && rest[0] == '\r') {
+                    m_state = State::DONE;
+                    return consumed;
+                }
+                break;
+            }
+            case State::DONE:
+            case State::ERROR:
+                return consumed;
+        }
+    }
+}
@@ -0,0 +1,299 @@
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Clock.h"
+#include "FileCache.h"
+#include "GzipCache.h"
+#include "HttpData.h"
+#include "Logger.h"
+#include "Utils.h"
+
+
+constexpr uint64_t FILECACHE_REPORT_MASK = 0xFFFF;  // 每 65536 次查询打印一次命中统计
+
+
+namespace {
+    // 打开普通文件，失败返回 -1
+    int open_regular_file(const std::string &path, struct stat &sbuf) {
+        int file_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (file_fd < 0) {
+            return -1;
+        }
+        if (fstat(file_fd, &sbuf) < 0 || !S_ISREG(sbuf.st_mode)) {
+            close(file_fd);
+            return -1;
+        }
+        return file_fd;
+    }
+
+    void load_content(CachedFile &file) {
+        if (file.size > 0 && file.size <= FILECACHE_INLINE_SIZE) {
+            file.content.resize(file.size);
+            // 读取时文件被修改，大小不一致，仍然使用 sendfile
+            if (readn(file.fd, file.content.data(), file.size) != static_cast<ssize_t>(file.size)) {
+                file.content.clear();
+            }
+        }
+    }
+
+    bool same_file(const CachedFile &file, const struct stat &st) {
+        return file.inode == st.st_ino
+            && file.size == static_cast<size_t>(st.st_size)
+            && file.mtime == st.st_mtime;
+    }
+}  // namespace
+
+
+// ==========================================================================
+// CachedFile
+
+CachedFile::CachedFile(int file_fd, const struct stat &st, std::string mime,
+                       std::string_view encoding, bool vary)
+    : fd(file_fd), size(static_cast<size_t>(st.st_size)), mtime(st.st_mtime),
+      inode(st.st_ino), mime_type(std::move(mime)) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "\"%lx-%zx-%lx\"",
+             static_cast<unsigned long>(inode), size, static_cast<unsigned long>(mtime));
+    etag = buf;
+    build_headers(encoding, vary);
+}
+
+
+CachedFile::CachedFile(const CachedFile &source, std::string_view encoding, std::string encoded_content)
+    : fd(-1), size(encoded_content.size()), mtime(source.mtime), inode(source.inode),
+      mime_type(source.mime_type), content(std::move(encoded_content)) {
+    // "\"1a2b-22bd-5f5e1000\"" -> "\"1a2b-22bd-5f5e1000-gzip\""
+    etag = source.etag.substr(0, source.etag.size() - 1);
+    etag += '-';
+    etag.append(encoding);
+    etag += '"';
+    build_headers(encoding, true);
+}
+
+
+// 所有响应共用的表示头和校验头，以及 200 响应的完整头部分
+void CachedFile::build_headers(std::string_view encoding, bool vary) {
+    char buf[64];
+    if (!encoding.empty()) {
+        common_header += "Content-Encoding: ";
+        common_header.append(encoding);
+        common_header += "\r\n";
+    }
+    if (vary) {
+        common_header += "Vary: Accept-Encoding\r\n";
+    }
+    common_header += "Server: Static Web Server\r\nLast-Modified: ";
+    common_header.append(buf, Clock::format_http_date(mtime, buf, sizeof(buf)));
+    common_header += "\r\nETag: " + etag + "\r\n";
+
+    header += "Content-Type: " + mime_type + "\r\n";
+    header += "Content-Length: " + std::to_string(size) + "\r\n";
+    header += "Accept-Ranges: bytes\r\n";
+    header += common_header;
+}
+
+
+CachedFile::~CachedFile() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+
+// ==========================================================================
+// FileCache
+
+FileCache &FileCache::instance() {
+    static FileCache cache;
+    return cache;
+}
+
+
+// 去掉多余的 '/' 和 "."，按字面解析 ".."，且不会越过根目录
+// 结果写入 path，复用其已有的空间
+void FileCache::normalize_path(std::string_view filename, std::string &path) {
+    path.clear();
+    size_t start = 0;
+    while (start <= filename.size()) {
+        size_t end = filename.find('/', start);
+        if (end == std::string_view::npos) {
+            end = filename.size();
+        }
+        std::string_view segment = filename.substr(start, end - start);
+        if (segment == "..") {
+            size_t slash_pos = path.rfind('/');
+            path.resize(slash_pos == std::string::npos ? 0 : slash_pos);
+        } else if (!segment.empty() && segment != ".") {
+            if (!path.empty()) {
+                path += '/';
+            }
+            path.append(segment);
+        }
+        start = end + 1;
+    }
+
+    if (path.empty()) {
+        path = ".";
+    }
+}
+
+
+// 按最后一个路径段的扩展名查找，没有扩展名时使用默认类型
+std::string FileCache::find_mime_type(const std::string &path) {
+    size_t slash_pos = path.rfind('/');
+    size_t dot_pos = path.rfind('.');
+    if (dot_pos == std::string::npos || (slash_pos != std::string::npos && dot_pos < slash_pos)) {
+        return MimeType::get_mime_type("default");
+    }
+    return MimeType::get_mime_type(path.substr(dot_pos));
+}
+
+
+bool FileCache::is_compressible(const std::string &mime_type) {
+    return mime_type.compare(0, 5, "text/") == 0
+        || mime_type == "application/javascript"
+        || mime_type == "application/json"
+        || mime_type == "image/svg+xml";
+}
+
+
+bool FileCache::is_encoded_fresh(const struct stat &source, const struct stat &encoded) {
+    return encoded.st_size > 0
+        && encoded.st_mtim.tv_sec == source.st_mtim.tv_sec
+        && encoded.st_mtim.tv_nsec == source.st_mtim.tv_nsec;
+}
+
+
+FileCache::CachedFilePtr FileCache::get(std::string_view filename) {
+    thread_local std::string path;
+    normalize_path(filename, path);
+    auto now = static_cast<int64_t>(Clock::now_ms());
+
+    CachedFilePtr cached;
+    {
+        MutexGuard lock(m_mutex);
+        auto it = m_entries.find(path);
+        if (it != m_entries.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+            if (now - it->second.validated_ms < m_revalidate_ms) {
+                count_lookup(true);
+                return it->second.file;
+            }
+            cached = it->second.file;
+        }
+    }
+
+    // 过期条目重新校验，stat 不在锁内进行
+    if (cached) {
+        struct stat sbuf;
+        if (stat(path.c_str(), &sbuf) == 0 && same_file(*cached, sbuf)) {
+            MutexGuard lock(m_mutex);
+            auto it = m_entries.find(path);
+            if (it != m_entries.end() && it->second.file == cached) {
+                it->second.validated_ms = now;
+            }
+            count_lookup(true);
+            return cached;
+        }
+    }
+
+    count_lookup(false);
+    CachedFilePtr file = open_file(path);
+
+    MutexGuard lock(m_mutex);
+    if (file) {
+        insert_guarded(path, file, now);
+    } else {
+        erase_guarded(path);
+    }
+    return file;
+}
+
+
+void FileCache::invalidate(std::string_view filename) {
+    std::string path;
+    normalize_path(filename, path);
+    MutexGuard lock(m_mutex);
+    erase_guarded(path);
+}
+
+
+FileCache::CachedFilePtr FileCache::open_file(const std::string &path) {
+    struct stat sbuf;
+    int file_fd = open_regular_file(path, sbuf);
+    if (file_fd < 0) {
+        return nullptr;
+    }
+    std::string mime_type = find_mime_type(path);
+
+    // 预压缩版本的修改时间和原文件不同时，是原文件修改前生成的
+    std::array<std::shared_ptr<const CachedFile>, CONTENT_ENCODING_COUNT> encoded;
+    bool vary = false;
+    if (is_compressible(mime_type)) {
+        for (size_t i = 0; i < CONTENT_ENCODING_COUNT; ++i) {
+            struct stat encoded_sbuf;
+            std::string encoded_path = path;
+            encoded_path.append(CONTENT_ENCODING_SUFFIXES[i]);
+            int encoded_fd = open_regular_file(encoded_path, encoded_sbuf);
+            if (encoded_fd < 0) {
+                continue;
+            }
+            if (!is_encoded_fresh(sbuf, encoded_sbuf)) {
+                close(encoded_fd);
+                continue;
+            }
+            auto encoded_file = std::make_shared<CachedFile>(
+                encoded_fd, encoded_sbuf, mime_type, CONTENT_ENCODING_NAMES[i], true);
+            load_content(*encoded_file);
+            encoded[i] = std::move(encoded_file);
+            vary = true;
+        }
+    }
+
+    // 会被动态压缩的文件，未压缩的响应也需要 Vary
+    vary = vary || GzipCache::instance().is_candidate(mime_type, static_cast<size_t>(sbuf.st_size));
+    auto file = std::make_shared<CachedFile>(file_fd, sbuf, std::move(mime_type), std::string_view(), vary);
+    load_content(*file);
+    file->encoded = std::move(encoded);
+    return file;
+}
+
+
+void FileCache::insert_guarded(const std::string &path, const CachedFilePtr &file, int64_t now) {
+    auto it = m_entries.find(path);
+    if (it != m_entries.end()) {
+        it->second.file = file;
+        it->second.validated_ms = now;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+        return;
+    }
+
+    m_lru.push_front(path);
+    m_entries.emplace(path, Entry{file, now, m_lru.begin()});
+
+    // 正在发送的连接仍持有 shared_ptr，被淘汰的 fd 在发送完之后才关闭
+    while (m_entries.size() > m_capacity) {
+        m_entries.erase(m_lru.back());
+        m_lru.pop_back();
+    }
+}
+
+
+void FileCache::erase_guarded(const std::string &path) {
+    auto it = m_entries.find(path);
+    if (it != m_entries.end()) {
+        m_lru.erase(it->second.lru_pos);
+        m_entries.erase(it);
+    }
+}
+
+
+void FileCache::count_lookup(bool hit) {
+    uint64_t hits = hit ? m_hits.fetch_add(1, std::memory_order_relaxed) + 1 : this->hits();
+    uint64_t misses = hit ? this->misses() : m_misses.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (((hits + misses) & FILECACHE_REPORT_MASK) == 0) {
+        LOG << "FileCache: hits = " << hits << ", misses = " << misses;
+    }
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "Clock.h"
+#include "GzipCache.h"
+#include "Logger.h"
+
+
+constexpr size_t GZIP_ENTRY_OVERHEAD = 256;   // 每个条目的 key、头部和链表节点，按固定值计入容量
+
+
+GzipCache &GzipCache::instance() {
+    static GzipCache cache;
+    return cache;
+}
+
+
+void GzipCache::set_enabled(bool enabled) noexcept {
+#ifdef HAVE_ZLIB
+    m_enabled = enabled;
+#else
+    if (enabled) {
+        LOG << "GzipCache: built without zlib, dynamic gzip disabled";
+    }
+    m_enabled = false;
+#endif
+}
+
+
+bool GzipCache::is_candidate(const std::string &mime_type, size_t size) const noexcept {
+    return m_enabled && size >= GZIP_MIN_SIZE && size <= GZIP_MAX_SIZE && FileCache::is_compressible(mime_type);
+}
+
+
+bool GzipCache::compress(std::string_view input, std::string &output, int level) {
+#ifdef HAVE_ZLIB
+    z_stream stream{};
+    // windowBits 加 16 输出 gzip 格式
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    output.resize(deflateBound(&stream, input.size()));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef *>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+    int ret = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+#else
+    (void)input;
+    (void)output;
+    (void)level;
+    return false;
+#endif
+}
+
+
+// 每个 loop 线程一个令牌桶，容量和每秒补充的量都是 m_budget
+bool GzipCache::take_budget(size_t bytes) const noexcept {
+    thread_local uint64_t t_last_ms = 0;
+    thread_local size_t t_tokens = 0;
+
+    uint64_t now = Clock::now_ms();
+    uint64_t elapsed = std::min<uint64_t>(now - t_last_ms, 1000);
+    t_tokens = std::min(m_budget, t_tokens + static_cast<size_t>(elapsed * m_budget / 1000));
+    t_last_ms = now;
+
+    if (t_tokens < bytes) {
+        return false;
+    }
+    t_tokens -= bytes;
+    return true;
+}
+
+
+FileCache::CachedFilePtr GzipCache::get(std::string_view filename, const FileCache::CachedFilePtr &file) {
+    // 路径和 ETag 之间用 '\0' 分隔，路径中不会出现
+    thread_local std::string key;
+    FileCache::normalize_path(filename, key);
+    key += '\0';
+    key += file->etag;
+    key += "gzip";
+
+    {
+        MutexGuard lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return it->second.file;
+        }
+    }
+
+    // 不在锁内压缩，多个线程同时未命中时各自压缩，后插入的覆盖先插入的
+    if (!take_budget(file->size)) {
+        return nullptr;
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+
+    std::string source;
+    std::string_view input = file->content;
+    if (input.empty()) {
+        source.resize(file->size);
+        if (pread(file->fd, source.data(), source.size(), 0) != static_cast<ssize_t>(source.size())) {
+            return nullptr;
+        }
+        input = source;
+    }
+
+    std::string output;
+    FileCache::CachedFilePtr gzip_file;
+    if (compress(input, output, GZIP_LEVEL) && output.size() < input.size()) {
+        gzip_file = std::make_shared<const CachedFile>(*file, "gzip", std::move(output));
+    }
+
+    MutexGuard lock(m_mutex);
+    insert_guarded(key, gzip_file, (gzip_file ? gzip_file->size : 0) + GZIP_ENTRY_OVERHEAD);
+    return gzip_file;
+}
+
+
+void GzipCache::insert_guarded(const std::string &key, const FileCache::CachedFilePtr &file, size_t charge) {
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_size -= it->second.charge;
+        it->second.file = file;
+        it->second.charge = charge;
+        m_size += charge;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru_pos);
+    } else {
+        m_lru.push_front(key);
+        m_entries.emplace(key, Entry{file, charge, m_lru.begin()});
+        m_size += charge;
+    }
+
+    // 正在发送的连接仍持有 shared_ptr，被淘汰的内容在发送完之后才释放
+    while (m_size > m_capacity && !m_lru.empty()) {
+        auto victim = m_entries.find(m_lru.back());
+        m_size -= victim->second.charge;
+        m_entries.erase(victim);
+        m_lru.pop_back();
+    }
+}
@@ -1,9 +1,13 @@
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
 
 #include "Channel.h"
+#include "Clock.h"
 #include "EventLoop.h"
+#include "GzipCache.h"
 #include "HttpData.h"
 
 #include "Debug.h"
@@ -11,8 +15,22 @@
 
 // ONESHOT :  after an event is received for that file descriptor, it will be automatically removed from the  epoll  interest list.
 constexpr uint32_t HTTP_DEFAULT_EVENT = EPOLLIN | EPOLLET | EPOLLONESHOT;
+// 连接只属于一个 loop 线程，持续注册的边沿触发只在监听的事件变化时才需要 epoll_ctl
+constexpr uint32_t HTTP_PERSISTENT_EVENT = EPOLLIN | EPOLLET;
 constexpr int EXPIRED_TIME = 2000;  // ms
 constexpr int KEEP_ALIVE_TIME = 5 * 60 * 1000;  // ms
+constexpr int OUTPUT_IOV_MAX = 64;   // 一次 sendmsg 最多的内存片段数
+constexpr size_t STREAM_HIGH_WATERMARK = 64 * 1024;   // 流式响应一次最多生成到发送队列中的字节数
+constexpr size_t HTTP_READ_ROUND_BYTES = 256 * 1024;  // handle_read 每轮读取的字节数
+constexpr size_t BODY_CHUNK_SIZE = 64 * 1024;         // 每次交给请求体处理者的最大字节数
+constexpr size_t LOG_REQUEST_BYTES = 2048;            // 日志中记录的请求最多字节数，一行日志的缓冲区是 4 KB
+
+constexpr std::string_view HTTP_200_STATUS = "HTTP/1.1 200 OK\r\n";
+constexpr std::string_view HTTP_206_STATUS = "HTTP/1.1 206 Partial Content\r\n";
+constexpr std::string_view HTTP_304_STATUS = "HTTP/1.1 304 Not Modified\r\n";
+constexpr std::string_view HTTP_416_STATUS = "HTTP/1.1 416 Range Not Satisfiable\r\n";
+static const std::string KEEP_ALIVE_HEADER =
+    "Connection: keep-alive\r\nKeep-Alive: timeout=" + std::to_string(KEEP_ALIVE_TIME) + "\r\n";
 
 
 // ==========================================================================
@@ -49,89 +67,200 @@ std::string MimeType::get_mime_type(const std::string &suffix) {
 }
 
 
+bool MimeType::contains(const std::string &suffix) {
+    return mime.find(suffix) != mime.end();
+}
+
+
+// Date 头使用 loop 线程本轮缓存的时间，每秒只格式化一次
+static void append_date_header(std::string &header) {
+    header += "Date: ";
+    header += Clock::http_date();
+    header += "\r\n";
+}
+
+
+// 200 响应的 Date 头每秒生成一次，发送队列中的响应共享同一个字符串，不需要拷贝
+static std::shared_ptr<const std::string> date_header_line() {
+    thread_local time_t t_seconds = -1;
+    thread_local std::shared_ptr<const std::string> t_line;
+    time_t now = Clock::wall_seconds();
+    if (now != t_seconds || !t_line) {
+        std::string line;
+        append_date_header(line);
+        t_line = std::make_shared<const std::string>(std::move(line));
+        t_seconds = now;
+    }
+    return t_line;
+}
+
+
 // ==========================================================================
 // HttpData
 
+bool HttpData::s_oneshot = true;
+std::vector<HttpData::StreamRoute> HttpData::s_stream_routes;
+
+
+std::vector<HttpData::BodyRoute> HttpData::s_body_routes;
+size_t HttpData::s_max_body_size = BODY_DEFAULT_MAX_SIZE;
+
+
+void HttpData::register_body_handler(std::string path, BodyHandler handler) {
+    s_body_routes.push_back(BodyRoute{std::move(path), std::move(handler)});
+}
+
+
+void HttpData::register_stream_handler(std::string path, std::string content_type, StreamHandler handler) {
+    StreamRoute route;
+    route.path = std::move(path);
+    route.header = "Content-Type: " + content_type + "\r\n";
+    route.header_http10 = route.header + "Connection: close\r\nServer: Static Web Server\r\n";
+    route.header += "Transfer-Encoding: chunked\r\nServer: Static Web Server\r\n";
+    route.handler = std::move(handler);
+    s_stream_routes.push_back(std::move(route));
+}
+
+
+// 每次 modify_poller 时的触发方式
+static uint32_t trigger_mode(bool oneshot) {
+    return oneshot ? (EPOLLET | EPOLLONESHOT) : EPOLLET;
+}
+
+
 HttpData::HttpData(EventLoop *loop, int connfd)
-    : m_event_loop(loop), m_connfd(connfd), 
-      m_channel(new Channel(loop, connfd)) {
-    m_channel->set_read_handler([this](){handle_read();});
-    m_channel->set_write_handler([this](){handle_write();});
-    m_channel->set_conn_handler([this](){handle_connect();});
+    : m_in_buf(&loop->get_memory_pool()),
+      m_out_queue(PoolAllocator<OutputSegment>(&loop->get_memory_pool())),
+      m_channel(loop, connfd), m_event_loop(loop), m_connfd(connfd) {
+    m_channel.set_read_handler([this](){handle_read();});
+    m_channel.set_write_handler([this](){handle_write();});
+    m_channel.set_conn_handler([this](){handle_connect();});
+    m_timer.set_callback([this](){handle_close();});
    
     // shared_from_this() 需要在 shared_ptr 构造完成之后使用
-    // m_channel->set_owner_http(shared_from_this());
+    // m_channel.set_owner_http(shared_from_this());
 }
 
 
-void HttpData::reset() {
-    m_filename.clear();
-    m_path.clear();
-    m_read_pos = 0;
+HttpData::~HttpData() {
+    shutdown(m_connfd, SHUT_RDWR);
+    close(m_connfd);
 
-    m_headers.clear();
-    m_process_state = ProcessState::STATE_PARSE_URI;
-    m_parse_state = ParseState::H_START;
-
-    detach_timer();
+    // 连接数在 Server 分配连接时增加
+    m_event_loop->add_pending_bytes(-static_cast<int64_t>(m_pending_bytes));
+    m_event_loop->remove_connection();
 }
 
 
-void HttpData::detach_timer() {
-    // clear weak_ptr
-    if (m_timer.lock()) {
-        std::shared_ptr<TimerNode> del_timer(m_timer.lock());
-        del_timer->invalidate_timer();
-        m_timer.reset();
-    }
+void HttpData::reset() {
+    m_parser.reset();
+    m_process_state = ProcessState::STATE_PARSE_URI;
+
+    detach_timer();
 }
 
 
 void HttpData::add_new_event() {
-    m_channel->set_events(HTTP_DEFAULT_EVENT);
-    m_event_loop->add_to_poller(m_channel, EXPIRED_TIME);
+    m_channel.set_events(s_oneshot ? HTTP_DEFAULT_EVENT : HTTP_PERSISTENT_EVENT);
+    m_event_loop->add_to_poller(get_channel(), EXPIRED_TIME);
 }
 
 
 void HttpData::handle_read() {
-    uint32_t &events = m_channel->get_events();
+    uint32_t &events = m_channel.get_events();
 
     // Reading Process
+    // 每轮最多读 HTTP_READ_ROUND_BYTES，处理之后再读，直到 EAGAIN。
+    // 请求体在每轮中交给处理者并从缓冲区移除，上传时接收缓冲区的大小不随请求体增长。
+    // 流式响应结束之前后面的请求不会处理: 先推进流式响应，发送缓冲区满时不再读取，
+    // 数据留在内核的接收缓冲区中由 TCP 流量控制限制对方。EPOLLIN 在流式响应结束后由 handle_connect 重新注册
     bool nodata_flag = false;
-    ssize_t read_num = read_utill_nodata(m_connfd, m_in_buf, nodata_flag);
-    LOG << "Request: " << m_in_buf << "\n";
-    if (m_connection_state == ConnectionState::H_DISCONNECTING) {
-        m_in_buf.clear();
-        goto out;
-    }
-    if (read_num < 0) {
-        perror("read from client.");
-        m_error = true;
-        handle_error(m_connfd, 400, "Bad Request");
-        goto out;
+    ssize_t read_num = 0;
+    do {
+        if (m_stream) {
+            handle_write();
+            if (m_error || m_stream) {
+                break;
+            }
+        }
+        read_num = m_in_buf.read_fd(m_connfd, nodata_flag, HTTP_READ_ROUND_BYTES);
+        if (m_connection_state == ConnectionState::H_DISCONNECTING) {
+            m_in_buf.retrieve_all();
+            goto out;
+        }
+        if (read_num < 0) {
+            perror("read from client.");
+            m_error = true;
+            handle_error(400, "Bad Request");
+            goto out;
+        }
+
+        if (nodata_flag) {
+            // 可能是数据未到达，或者对方异常关闭，都按照关闭处理
+            m_connection_state = ConnectionState::H_DISCONNECTING;
+            if (read_num == 0) {
+                goto out;
+            }
+        }
+
+        // 响应按顺序进入 m_out_queue，在 out 中一起写出
+        process_requests();
+    } while (!m_error && !nodata_flag && static_cast<size_t>(read_num) >= HTTP_READ_ROUND_BYTES);
+
+out:
+    // 很烂的代码，真的
+    if (!m_error) {
+        if (has_pending_output()) {
+            handle_write();
+        }
+
+        // 可能在 handle_write 改变了 m_error
+        // 请求未接收完整，注册 EPOLLIN
+        if (!m_error && m_connection_state != ConnectionState::H_DISCONNECTED && !m_stream
+            && (m_process_state != ProcessState::STATE_PARSE_URI || !m_in_buf.empty())) {
+            events |= EPOLLIN;
+        }
     }
 
-    if (nodata_flag) {
-        // 可能是数据未到达，或者对方异常关闭，都按照关闭处理
-        m_connection_state = ConnectionState::H_DISCONNECTING;
-        if (read_num == 0) {
-            goto out;
+    // 请求都已处理完，缓冲区块还给 MemoryPool，空闲的连接不占用内存
+    m_in_buf.shrink_if_empty();
+
+    // 如果出错，会在 handle_connent 处理
+}
+
+
+// pipelining: 输入缓冲区中所有完整的请求，在一次调用中解析并应答
+void HttpData::process_requests() {
+    while (process_request()) {
+        this->reset();
+        if (m_in_buf.empty()) {
+            break;
         }
     }
+}
+
+
+// 处理 m_in_buf 中的一个请求，请求应答完毕返回 true。数据不完整或者出错返回 false，出错时设置 m_error
+bool HttpData::process_request() {
+    // 流式响应结束之前，后面的请求留在 m_in_buf 中
+    if (m_stream) {
+        return false;
+    }
 
-    // Parse Request
     if (m_process_state == ProcessState::STATE_PARSE_URI) {
         URIState flag = this->parse_URI();
         if (flag == URIState::PARSE_URI_AGAIN) {
-            goto out;
+            return false;
         }
         if (flag == URIState::PARSE_URI_ERROR) {
             perror("parse_URI error");
-            LOG << "FD = " << m_connfd << ", " << m_in_buf << "*** Error. \n";
-            m_in_buf.clear();
+            // 出错时缓冲区中可能有一整轮的数据，只记录开头的部分
+            LOG << "FD = " << m_connfd << ", " << m_in_buf.readable().substr(0, LOG_REQUEST_BYTES)
+                << "*** Error. \n";
+            m_in_buf.retrieve_all();
             m_error = true;
-            handle_error(m_connfd, 400, "Bad Request");
-            goto out;
+            handle_error(400, "Bad Request");
+            return false;
         }
         m_process_state = ProcessState::STATE_PARSE_HEADERS;
     }
@@ -139,98 +268,203 @@ void HttpData::handle_read() {
     if (m_process_state == ProcessState::STATE_PARSE_HEADERS) {
         HeaderState flag = this->parse_headers();
         if (flag == HeaderState::PARSE_HEADER_AGAIN) {
-            goto out;
+            return false;
         }
         if (flag == HeaderState::PARSE_HEADER_ERROR) {
             perror("parse_headers error");
-            LOG << "FD = " << m_connfd << ", " << m_in_buf << "*** Error. \n";
-            m_in_buf.clear();
-            handle_error(m_connfd, 400, "Bad Request");
-            goto out;
+            LOG << "FD = " << m_connfd << ", " << m_in_buf.readable().substr(0, LOG_REQUEST_BYTES)
+                << "*** Error. \n";
+            m_in_buf.retrieve_all();
+            m_error = true;
+            handle_error(400, "Bad Request");
+            return false;
         }
+        // 只记录请求行和请求头，请求体和流水线中后面的请求不记录
+        LOG << "Request: " << m_in_buf.readable().substr(0, std::min(m_parser.header_length(), LOG_REQUEST_BYTES))
+            << "\n";
 
         if (m_method == HttpMethod::METHOD_POST) {
+            // 请求头在这里处理完，之后缓冲区中只保留请求体
+            if (!begin_body()) {
+                m_error = true;
+                return false;
+            }
+            m_in_buf.retrieve(m_parser.header_length());
             m_process_state = ProcessState::STATE_RECV_BODY;
         } else {
             m_process_state = ProcessState::STATE_ANALYSIS;
         }
     }
 
-    // prepare for post analysis, but not supported indead.
+    // 请求体边接收边交给处理者，接收完之后生成响应
     if (m_process_state == ProcessState::STATE_RECV_BODY) {
-        int content_length = -1;
-        if (m_headers.find("Content-Length") != m_headers.end()) {
-            content_length = std::stoi(m_headers["Content-Length"]);
-        } else {
-            m_error = true;
-            handle_error(m_connfd, 400, "Bad Request: Content-Length not find");
-            goto out;
-        }
-        if (static_cast<int>(m_in_buf.size()) < content_length) {
-            goto out;
+        if (!receive_body()) {
+            return false;
         }
-        m_process_state = ProcessState::STATE_ANALYSIS;
-    }    
+        m_process_state = ProcessState::STATE_FINISH;
+    }
 
     if (m_process_state == ProcessState::STATE_ANALYSIS) {
         AnalysisState flag = this->analysis_request();
-        if (flag == AnalysisState::ANALYSIS_SUCCESS) {
-            m_process_state = ProcessState::STATE_FINISH;
-            goto out;
-        } else {
+        if (flag != AnalysisState::ANALYSIS_SUCCESS) {
             m_error = true;
-            goto out;
+            return false;
         }
-    }
+        m_process_state = ProcessState::STATE_FINISH;
 
-out:
-    // 很烂的代码，真的
-    if (!m_error) {
-        if (!m_out_buf.empty()) {
-            handle_write();
-        }
-
-        // 可能在 handle_write 改变了 m_error
-        if (!m_error && m_process_state == ProcessState::STATE_FINISH) {
-            this->reset();
-            // // 检查未读完数据
-            // if (!m_in_buf.empty() 
-            //     && m_connection_state == ConnectionState::H_CONNECTED) {
-            //     handle_read();
-            // }
-        // 注册 EPOLLIN
-        } else if (!m_error && m_connection_state != ConnectionState::H_DISCONNECTED) {
-            events |= EPOLLIN;
-        }
+        // 请求应答完毕，从输入缓冲区中移除 (只移动读位置)，之后是流水线中的下一个请求
+        m_in_buf.retrieve(m_parser.header_length());
     }
 
-    // 如果出错，会在 handle_connent 处理
+    return m_process_state == ProcessState::STATE_FINISH;
 }
 
 
 void HttpData::handle_write() {
     if (!m_error && m_connection_state != ConnectionState::H_DISCONNECTED) {
-        uint32_t &events = m_channel->get_events();
-        if (writen(m_connfd, m_out_buf) < 0) {
-            perror("writen to client.");
+        uint32_t &events = m_channel.get_events();
+        bool ok = flush_output();
+
+        // 流式响应: 发送队列清空后继续生成，发送缓冲区满时等待 EPOLLOUT，内存中最多有一个高水位的数据
+        while (ok && m_stream && !has_pending_output()) {
+            produce_stream();
+            if (!m_stream) {
+                // 响应结束，处理流水线中等待的请求
+                process_requests();
+            }
+            ok = !m_error && flush_output();
+        }
+
+        if (!ok) {
             events = 0;
             m_error = true;
         }
-        if (!m_out_buf.empty()) {
+        if (has_pending_output()) {
             events |= EPOLLOUT;
         }
-        if (m_out_buf.empty() && !m_keep_alive && !m_closed) {
+        // 100 Continue 之后还要接收请求体，不能关闭
+        if (!has_pending_output() && !m_stream && !m_keep_alive && !m_closed
+            && m_process_state != ProcessState::STATE_RECV_BODY) {
             m_closed = true;
-            shutdown_WR(m_channel->get_fd());
+            shutdown_WR(m_channel.get_fd());
+        }
+    }
+}
+
+
+// 相邻的自有数据合并到同一个片段
+void HttpData::append_output(std::string_view data) {
+    if (data.empty()) {
+        return;
+    }
+    if (m_out_queue.empty() || m_out_queue.back().data.empty()) {
+        m_out_queue.emplace_back();
+    }
+    m_out_queue.back().data.append(data);
+    update_pending_bytes(static_cast<int64_t>(data.size()));
+}
+
+
+void HttpData::append_output_view(std::string_view data, std::shared_ptr<const void> owner) {
+    if (data.empty()) {
+        return;
+    }
+    OutputSegment &segment = m_out_queue.emplace_back();
+    segment.view = data;
+    segment.owner = std::move(owner);
+    update_pending_bytes(static_cast<int64_t>(data.size()));
+}
+
+
+void HttpData::append_output_file(FileCache::CachedFilePtr file, off_t offset, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    OutputSegment &segment = m_out_queue.emplace_back();
+    segment.file = std::move(file);
+    segment.file_offset = offset;
+    segment.file_remain = length;
+    update_pending_bytes(static_cast<int64_t>(length));
+}
+
+
+void HttpData::update_pending_bytes(int64_t delta) {
+    m_pending_bytes = static_cast<size_t>(static_cast<int64_t>(m_pending_bytes) + delta);
+    m_event_loop->add_pending_bytes(delta);
+}
+
+
+// 按顺序发送 m_out_queue，发送缓冲区满时保留剩余部分。出错返回 false
+// 小文件的响应 (响应头和缓存的文件内容)，以及流水线中连续的多个这样的响应，只需要一次 sendmsg
+bool HttpData::flush_output() {
+    while (!m_out_queue.empty()) {
+        OutputSegment &segment = m_out_queue.front();
+        if (segment.file_remain > 0) {
+            size_t file_remain = segment.file_remain;
+            ssize_t ret = sendfilen(m_connfd, segment.file->fd, segment.file_offset, segment.file_remain);
+            update_pending_bytes(static_cast<int64_t>(segment.file_remain) - static_cast<int64_t>(file_remain));
+            if (ret < 0) {
+                perror("sendfilen to client.");
+                return false;
+            }
+            if (segment.file_remain > 0) {
+                return true;
+            }
+            m_out_queue.pop_front();
+            continue;
+        }
+
+        // 队首连续的内存片段
+        struct iovec iov[OUTPUT_IOV_MAX];
+        int iovcnt = 0;
+        size_t total = 0;
+        auto it = m_out_queue.begin();
+        for (; it != m_out_queue.end() && it->file_remain == 0 && iovcnt < OUTPUT_IOV_MAX; ++it) {
+            std::string_view data = it->pending_data();
+            iov[iovcnt].iov_base = const_cast<char *>(data.data());
+            iov[iovcnt].iov_len = data.size();
+            ++iovcnt;
+            total += data.size();
+        }
+
+        // 后面还有数据时 (通常是 sendfile 的文件) 带 MSG_MORE，响应头和文件的开头在同一个报文中发出
+        ssize_t ret = sendmsgn(m_connfd, iov, iovcnt, it != m_out_queue.end());
+        if (ret < 0) {
+            perror("sendmsgn to client.");
+            return false;
+        }
+        consume_output(static_cast<size_t>(ret));
+        if (static_cast<size_t>(ret) < total) {
+            return true;
         }
     }
+    return true;
+}
+
+
+void HttpData::consume_output(size_t n) {
+    update_pending_bytes(-static_cast<int64_t>(n));
+    while (n > 0) {
+        OutputSegment &segment = m_out_queue.front();
+        size_t size = segment.pending_data().size();
+        if (n < size) {
+            if (segment.data.empty()) {
+                segment.view.remove_prefix(n);
+            } else {
+                segment.data_sent += n;
+            }
+            return;
+        }
+        n -= size;
+        m_out_queue.pop_front();
+    }
 }
 
 
 void HttpData::handle_connect() {
-    detach_timer();  // 这个会在 timer 的 invalide_timer 中，将 HttpData指针重置
+    detach_timer();
 
-    uint32_t &events = m_channel->get_events();
+    uint32_t &events = m_channel.get_events();
     PRINT("Handle connetion. events is " << events);
 
     // ConnectionState 三种状态 H_CONNECTED, H_DISCONNECTING, H_DISCONNECTED
@@ -247,23 +481,25 @@ void HttpData::handle_connect() {
                 events |= EPOLLOUT;
             }
             
-            events |= EPOLLET;
+            events |= trigger_mode(s_oneshot);
             // 修改事件后，再次主动触发事
-            // 注意 默认注册的初始事件，是包含 EPOLLONESHOT 的
-            m_event_loop->modify_poller(m_channel, timeout);
+            // ONESHOT 模式每次都重新注册，持续注册模式只有事件变化时才调用 epoll_ctl
+            m_event_loop->modify_poller(get_channel(), timeout);
         } else if (m_keep_alive) {
-            events |= (EPOLLIN | EPOLLET);
+            events |= (EPOLLIN | trigger_mode(s_oneshot));
             int timeout = KEEP_ALIVE_TIME;
-            m_event_loop->modify_poller(m_channel, timeout);
+            m_event_loop->modify_poller(get_channel(), timeout);
         } else {  // 不是 keep alive 的，但是 connect 了已经建立的连接，更新 timeout
-            events |= (EPOLLIN | EPOLLET);
+            events |= (EPOLLIN | trigger_mode(s_oneshot));
             int timeout = (KEEP_ALIVE_TIME >> 1);
-            m_event_loop->modify_poller(m_channel, timeout);
+            m_event_loop->modify_poller(get_channel(), timeout);
         }
     } else if (!m_error 
                && m_connection_state == ConnectionState::H_DISCONNECTING 
                && (events & EPOLLOUT)) { 
-        events = (EPOLLOUT | EPOLLET);  // 关闭中，发送剩余数据
+        // 关闭中，发送剩余数据。之前注册的可能只有 EPOLLIN，需要改为等待 EPOLLOUT
+        events = (EPOLLOUT | trigger_mode(s_oneshot));
+        m_event_loop->modify_poller(get_channel(), EXPIRED_TIME);
     } else {
         // m_event_loop->run_in_loop([this](){this->handle_close();});  // 这里实际增加了负载，真的没有必要
         handle_close();
@@ -271,9 +507,8 @@ void HttpData::handle_connect() {
 }
 
 
-void HttpData::handle_error(int fd, int err_num, std::string short_msg) {
+void HttpData::handle_error(int err_num, std::string short_msg) {
     short_msg = " " + short_msg;
-    char send_buff[4096];
     std::string body_buff, header_buff;
     body_buff += "<html><title>HTTP ERROR</title>";
     body_buff += "<body bgcolor=\"ffffff\">";
@@ -285,298 +520,534 @@ void HttpData::handle_error(int fd, int err_num, std::string short_msg) {
     header_buff += "Connection: Close\r\n";
     header_buff += "Content-Length: " + std::to_string(body_buff.size()) + "\r\n";
     header_buff += "Server: Static Web Server\r\n";
+    append_date_header(header_buff);
     header_buff += "\r\n";
 
-    // 错误处理不考虑writen是否传送完
-    (void)sprintf(send_buff, "%s", header_buff.c_str());
-    writen(fd, send_buff, strlen(send_buff));
-    (void)sprintf(send_buff, "%s", body_buff.c_str());
-    writen(fd, send_buff, strlen(send_buff));
+    // 排在流水线中之前的响应后面，错误处理不考虑是否传送完
+    append_output(header_buff);
+    append_output(body_buff);
+    (void)flush_output();
 }
 
 
 void HttpData::handle_close() {
     m_connection_state = ConnectionState::H_DISCONNECTED;
     std::shared_ptr<HttpData> guard(shared_from_this());   // 防止 reset 指针时出错
-    m_event_loop->remove_from_poller(m_channel);
+    m_event_loop->remove_from_poller(get_channel());
     if (!m_closed) {
-        shutdown_WR(m_channel->get_fd());
+        shutdown_WR(m_channel.get_fd());
     }
     // 此时由 guard 的析构，close(m_connfd)
 }
 
 
 URIState HttpData::parse_URI() {
-    std::string& content = m_in_buf;
+    URIState flag = m_parser.parse_request_line(m_in_buf.readable());
+    if (flag == URIState::PARSE_URI_SUCCESS) {
+        m_method = m_parser.method();
+        m_http_version = m_parser.version();
+    }
+    return flag;
+}
+
+
+HeaderState HttpData::parse_headers() {
+    return m_parser.parse_headers(m_in_buf.readable());
+}
 
-    // 有完整请求行(第一行)之后再解析
-    size_t pos = content.find('\r', m_read_pos);
-    if (pos == content.npos) {
-        return URIState::PARSE_URI_AGAIN;
+
+// If-None-Match 的值是 "*" 或者逗号分隔的 entity-tag 列表，GET/HEAD 按弱比较匹配 (忽略 W/ 前缀)
+static bool etag_matches(std::string_view list, std::string_view etag) {
+    size_t pos = 0;
+    while (pos < list.size()) {
+        if (list[pos] == ' ' || list[pos] == '\t' || list[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        if (list[pos] == '*') {
+            return true;
+        }
+        if (list.compare(pos, 2, "W/") == 0) {
+            pos += 2;
+        }
+        if (pos >= list.size() || list[pos] != '"') {
+            return false;
+        }
+        size_t close = list.find('"', pos + 1);
+        if (close == std::string_view::npos) {
+            return false;
+        }
+        if (list.substr(pos, close - pos + 1) == etag) {
+            return true;
+        }
+        pos = close + 1;
     }
+    return false;
+}
 
-    // 截取出请求行
-    std::string request_line = content.substr(0, pos);
-    if (content.size() > pos + 1) {
-        content = content.substr(pos + 1);
-    } else {
-        content.clear();
-    }
-
-    size_t get_pos = request_line.find("GET");
-    size_t post_pos = request_line.find("POST");
-    size_t head_pos = request_line.find("HEAD");
-
-    if (get_pos != std::string::npos) {
-        pos = get_pos;
-        m_method = HttpMethod::METHOD_GET;
-    } else if (post_pos != std::string::npos) {
-        pos = post_pos;
-        m_method = HttpMethod::METHOD_POST;
-    } else if (head_pos != std::string::npos) {
-        pos = head_pos;
-        m_method = HttpMethod::METHOD_HEAD;
-    } else {
-        return URIState::PARSE_URI_ERROR;
+
+// RFC 7232: 有 If-None-Match 时忽略 If-Modified-Since，无法解析的日期按没有这个头处理
+bool HttpData::is_not_modified(const CachedFile &file) {
+    const HttpHeaders &headers = m_parser.headers(m_in_buf.readable());
+    if (headers.contains("If-None-Match")) {
+        return etag_matches(headers.get("If-None-Match"), file.etag);
     }
 
-    // 默认 index.html
-    pos = request_line.find('/', pos);
-    if (pos < 0) {
-        m_filename = "index.html";
-        m_http_version = HttpVersion::HTTP_11;
-        return URIState::PARSE_URI_SUCCESS;
+    std::string_view since = headers.get("If-Modified-Since");
+    time_t since_seconds = 0;
+    return !since.empty() && Clock::parse_http_date(since, since_seconds) && file.mtime <= since_seconds;
+}
+
+
+// If-Range 是 entity-tag 时按强比较 (弱 ETag 不匹配)，是日期时必须和 Last-Modified 完全相同
+bool HttpData::if_range_matches(const CachedFile &file) {
+    const HttpHeaders &headers = m_parser.headers(m_in_buf.readable());
+    if (!headers.contains("If-Range")) {
+        return true;
     }
 
-    // 获取文件名
-    size_t file_name_end = request_line.find(' ', pos);
-    if (file_name_end == std::string::npos) {
-        return URIState::PARSE_URI_ERROR;
-    } 
-    if (file_name_end - pos > 1) {
-        m_filename = request_line.substr(pos + 1, file_name_end - pos - 1);
-        size_t qmark_pos = m_filename.find('?');
-        if (qmark_pos != std::string::npos) {
-            m_filename = m_filename.substr(0, qmark_pos);
+    std::string_view value = headers.get("If-Range");
+    if (!value.empty() && value.front() == '"') {
+        return value == file.etag;
+    }
+    time_t seconds = 0;
+    return value.compare(0, 2, "W/") != 0 && Clock::parse_http_date(value, seconds) && seconds == file.mtime;
+}
+
+
+// Accept-Encoding 的参数中 q=0 表示不接受这个编码
+static bool is_zero_qvalue(std::string_view params) {
+    size_t q_pos = params.find("q=");
+    if (q_pos == std::string_view::npos) {
+        q_pos = params.find("Q=");
+    }
+    if (q_pos == std::string_view::npos) {
+        return false;
+    }
+    std::string_view qvalue = params.substr(q_pos + 2);
+    size_t end = qvalue.find_first_not_of("0123456789.");
+    qvalue = qvalue.substr(0, end);
+    return !qvalue.empty() && qvalue.find_first_not_of("0.") == std::string_view::npos;
+}
+
+
+// 返回 Accept-Encoding 接受的编码，下标和 CONTENT_ENCODING_NAMES 对应。
+// 明确列出的编码优先于 "*"，x-gzip 等同于 gzip
+static std::array<bool, CONTENT_ENCODING_COUNT> accepted_encodings(std::string_view value) {
+    std::array<bool, CONTENT_ENCODING_COUNT> accepted{};
+    std::array<bool, CONTENT_ENCODING_COUNT> listed{};
+    bool any = false;
+
+    while (!value.empty()) {
+        size_t comma_pos = value.find(',');
+        std::string_view item = value.substr(0, comma_pos);
+        value.remove_prefix(comma_pos == std::string_view::npos ? value.size() : comma_pos + 1);
+
+        size_t semicolon_pos = item.find(';');
+        std::string_view coding = item.substr(0, semicolon_pos);
+        bool acceptable = semicolon_pos == std::string_view::npos || !is_zero_qvalue(item.substr(semicolon_pos + 1));
+        while (!coding.empty() && (coding.front() == ' ' || coding.front() == '\t')) {
+            coding.remove_prefix(1);
+        }
+        while (!coding.empty() && (coding.back() == ' ' || coding.back() == '\t')) {
+            coding.remove_suffix(1);
+        }
+        if (HttpHeaders::equals_ignore_case(coding, "x-gzip")) {
+            coding = "gzip";
+        }
+
+        if (coding == "*") {
+            any = acceptable;
+            continue;
+        }
+        for (size_t i = 0; i < CONTENT_ENCODING_COUNT; ++i) {
+            if (HttpHeaders::equals_ignore_case(coding, CONTENT_ENCODING_NAMES[i])) {
+                listed[i] = true;
+                accepted[i] = acceptable;
+            }
         }
-    } else {
-        m_filename = "index.html";
     }
-    pos = file_name_end;
 
-    // HTTP 版本解析
-    pos = request_line.find('/', pos);
-    if (pos == std::string::npos) {
-        return URIState::PARSE_URI_ERROR;
+    for (size_t i = 0; i < CONTENT_ENCODING_COUNT; ++i) {
+        if (!listed[i]) {
+            accepted[i] = any;
+        }
+    }
+    return accepted;
+}
+
+
+// 预压缩版本优先，都没有时可以动态 gzip 压缩
+FileCache::CachedFilePtr HttpData::select_encoding(std::string_view filename, FileCache::CachedFilePtr file) {
+    GzipCache &gzip_cache = GzipCache::instance();
+    bool gzip_candidate = gzip_cache.is_candidate(file->mime_type, file->size);
+    if (!file->has_encoded() && !gzip_candidate) {
+        return file;
+    }
+    std::string_view value = m_parser.headers(m_in_buf.readable()).get("Accept-Encoding");
+    if (value.empty()) {
+        return file;
     }
 
-    if (request_line.size() - pos <= 3) {
-        return URIState::PARSE_URI_ERROR;
+    std::array<bool, CONTENT_ENCODING_COUNT> accepted = accepted_encodings(value);
+    for (size_t i = 0; i < CONTENT_ENCODING_COUNT; ++i) {
+        if (accepted[i] && file->encoded[i]) {
+            return file->encoded[i];
+        }
     }
 
-    std::string ver_str = request_line.substr(pos + 1, 3);
-    if (ver_str == "1.0") {
-        m_http_version = HttpVersion::HTTP_10;
-    } else if (ver_str == "1.1") {
-        m_http_version = HttpVersion::HTTP_11;
-    } else {
-        return URIState::PARSE_URI_ERROR;
+    constexpr size_t gzip_index = CONTENT_ENCODING_COUNT - 1;
+    static_assert(CONTENT_ENCODING_NAMES[gzip_index] == "gzip");
+    if (gzip_candidate && accepted[gzip_index]) {
+        FileCache::CachedFilePtr gzip_file = gzip_cache.get(filename, file);
+        if (gzip_file) {
+            return gzip_file;
+        }
     }
+    return file;
+}
+
 
-    return URIState::PARSE_URI_SUCCESS;
+// 响应头大部分是引用: 静态的状态行、FileCache 预生成的部分、本秒共享的 Date 头
+// extra_header 是连接生成的部分，比如 Content-Range
+void HttpData::append_response_head(std::string_view status_line, std::string_view header,
+                                    std::shared_ptr<const void> owner, std::string_view extra_header) {
+    append_output_view(status_line);
+    if (m_keep_alive) {
+        append_output_view(KEEP_ALIVE_HEADER);
+    }
+    append_output(extra_header);
+    append_output_view(header, std::move(owner));
+    std::shared_ptr<const std::string> date_line = date_header_line();
+    std::string_view date_view = *date_line;
+    append_output_view(date_view, std::move(date_line));
+    append_output_view("\r\n");
 }
 
 
-HeaderState HttpData::parse_headers() {
-    std::string& content = m_in_buf;
-    size_t key_start = 0, key_end = 0, value_start = 0, value_end = 0;
-    size_t current_pos = 0;
-    bool is_finished = false;
-
-    // 有限状态机解析 HTTP 请求头
-    size_t i = 0;
-    for ( ; i < content.size() && !is_finished; ++i) {
-        switch (m_parse_state) {
-            case ParseState::H_START: {
-                if (content[i] == '\r' || content[i] == '\n') {
-                    break;
-                }
-                m_parse_state = ParseState::H_KEY;
-                key_start = i;
-                current_pos = i;
-                break;
-            }
+bool HttpData::start_stream(std::string_view path) {
+    for (const StreamRoute &route: s_stream_routes) {
+        if (route.path != path) {
+            continue;
+        }
 
-            case ParseState::H_KEY: {
-                if (content[i] == ':') {
-                    key_end = i;
-                    if (key_end - key_start <= 0) {
-                        return HeaderState::PARSE_HEADER_ERROR;
-                    }
-                    m_parse_state = ParseState::H_COLON;
-                } else if (content[i] == '\r' || content[i] == '\n') {
-                    return HeaderState::PARSE_HEADER_ERROR;
-                }
-                break;
-            }
-            
-            case ParseState::H_COLON: {
-                if (content[i] == ' ') {
-                    m_parse_state = ParseState::H_SPACES_AFTER_COLON;
-                } else {
-                    return HeaderState::PARSE_HEADER_ERROR;
-                }
-                break;
-            }
+        // HTTP/1.0 不支持 chunked，响应以关闭连接结束
+        m_stream_chunked = m_http_version != HttpVersion::HTTP_10;
+        if (!m_stream_chunked) {
+            m_keep_alive = false;
+        }
+        append_response_head(HTTP_200_STATUS, m_stream_chunked ? route.header : route.header_http10, nullptr);
+        if (m_method != HttpMethod::METHOD_HEAD) {
+            m_stream = route.handler();
+        }
+        return true;
+    }
+    return false;
+}
 
-            case ParseState::H_VALUE: {
-                if (content[i] == '\r') {
-                    m_parse_state = ParseState::H_CR;
-                    value_end = i;
-                    if (value_end - value_start <= 0) {
-                        return HeaderState::PARSE_HEADER_ERROR;
-                    }
-                } else if (i - value_start > 255) {
-                    return HeaderState::PARSE_HEADER_ERROR;
-                }
-                break;                
-            }
 
-            case ParseState::H_SPACES_AFTER_COLON: {
-                m_parse_state = ParseState::H_VALUE;
-                value_start = i;
-                break;
-            }
-            // \n
-            case ParseState::H_CR: {
-                if (content[i] == '\n') {
-                    m_parse_state = ParseState::H_LF;
-                    std::string key(content.begin() + key_start, content.begin() + key_end);
-                    std::string value(content.begin() + value_start, content.begin() + value_end);
-                    m_headers[key] = value;
-                    current_pos = i;
-                } else {
-                    return HeaderState::PARSE_HEADER_ERROR;
-                }
-                break;
+void HttpData::produce_stream() {
+    while (m_stream && m_pending_bytes < STREAM_HIGH_WATERMARK) {
+        m_stream_chunk.clear();
+        bool more = m_stream(m_stream_chunk);
+
+        // 长度为 0 的 chunk 表示结束，空数据不发送
+        if (!m_stream_chunk.empty()) {
+            if (m_stream_chunked) {
+                char size_line[32];
+                int len = snprintf(size_line, sizeof(size_line), "%zx\r\n", m_stream_chunk.size());
+                append_output(std::string_view(size_line, static_cast<size_t>(len)));
+                append_output(m_stream_chunk);
+                append_output("\r\n");
+            } else {
+                append_output(m_stream_chunk);
             }
+        }
 
-            case ParseState::H_LF: {
-                // 此时读取到 结束行 \r\n
-                if (content[i] == '\r') {
-                    m_parse_state = ParseState::H_END_CR;
-                } else {
-                    key_start = i;
-                    m_parse_state = ParseState::H_KEY;
-                }
-                break;
+        if (!more) {
+            if (m_stream_chunked) {
+                append_output_view("0\r\n\r\n");
             }
+            m_stream = nullptr;
+        }
+    }
 
-            case ParseState::H_END_CR: {
-                if (content[i] == '\n') {
-                    m_parse_state = ParseState::H_END_LF;
-                } else {
-                    return HeaderState::PARSE_HEADER_ERROR;
-                }
-                break;
-            }
+    // 大的 chunk 不保留缓冲区
+    if (!m_stream) {
+        std::string().swap(m_stream_chunk);
+    }
+}
 
-            case ParseState::H_END_LF: {
-                is_finished = true;
-                key_start = i;
-                current_pos = i;
-                break;
+
+// 检查请求体的长度和编码，创建处理者。请求头在返回后从缓冲区移除，需要的信息都在这里取出
+bool HttpData::begin_body() {
+    const HttpHeaders &headers = m_parser.headers(m_in_buf.readable());
+    if (HttpHeaders::equals_ignore_case(headers.get("Connection"), "keep-alive")) {
+        m_keep_alive = true;
+    }
+
+    std::string_view path = m_parser.path(m_in_buf.readable());
+    const BodyRoute *route = nullptr;
+    for (const BodyRoute &body_route: s_body_routes) {
+        if (body_route.path == path) {
+            route = &body_route;
+            break;
+        }
+    }
+    if (route == nullptr) {
+        handle_error(403, "Forbidden Request.");
+        return false;
+    }
+
+    // 同时有 Transfer-Encoding 和 Content-Length 的请求可能被前后两端解释成不同的边界，直接拒绝
+    bool has_length = headers.contains("Content-Length");
+    m_body_chunked = headers.contains("Transfer-Encoding");
+    if (m_body_chunked) {
+        if (has_length || !HttpHeaders::equals_ignore_case(headers.get("Transfer-Encoding"), "chunked")) {
+            handle_error(400, "Bad Request: Transfer-Encoding");
+            return false;
+        }
+        m_chunked_decoder.reset();
+    } else {
+        if (!has_length) {
+            handle_error(411, "Length Required");
+            return false;
+        }
+        // 只接受十进制数字，溢出、符号和多余的字符都是错误
+        std::string_view value = headers.get("Content-Length");
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), m_body_remaining);
+        if (value.empty() || ec != std::errc() || end != value.data() + value.size()) {
+            handle_error(400, "Bad Request: Content-Length");
+            return false;
+        }
+        if (m_body_remaining > s_max_body_size) {
+            handle_error(413, "Payload Too Large");
+            return false;
+        }
+    }
+
+    // 客户端等待 100 Continue 之后才发送请求体。已经收到请求体时不需要再发送
+    if (headers.contains("Expect")) {
+        if (!HttpHeaders::equals_ignore_case(headers.get("Expect"), "100-continue")) {
+            handle_error(417, "Expectation Failed");
+            return false;
+        }
+        if (m_http_version == HttpVersion::HTTP_11 && m_in_buf.readable_bytes() == m_parser.header_length()) {
+            append_output_view("HTTP/1.1 100 Continue\r\n\r\n");
+        }
+    }
+
+    m_body_received = 0;
+    m_body_consumer = route->handler();
+    return true;
+}
+
+
+// 请求体接收完返回 true。数据不完整或者出错返回 false，出错时设置 m_error
+bool HttpData::receive_body() {
+    if (!m_body_chunked) {
+        while (m_body_remaining > 0) {
+            size_t n = std::min({m_in_buf.readable_bytes(), m_body_remaining, BODY_CHUNK_SIZE});
+            if (n == 0) {
+                return false;
+            }
+            if (!deliver_body(m_in_buf.readable().substr(0, n))) {
+                return false;
             }
+            m_in_buf.retrieve(n);
+            m_body_remaining -= n;
         }
+        return finish_body();
     }
 
-    if (m_parse_state == ParseState::H_END_LF) {
-        content = content.substr(i);
-        return HeaderState::PARSE_HEADER_SUCCESS;
+    while (!m_chunked_decoder.done()) {
+        std::string_view data;
+        size_t consumed = m_chunked_decoder.decode(m_in_buf.readable(), BODY_CHUNK_SIZE, data);
+        if (m_chunked_decoder.error()) {
+            m_error = true;
+            handle_error(400, "Bad Request: chunked body");
+            return false;
+        }
+        if (!data.empty() && !deliver_body(data)) {
+            return false;
+        }
+        m_in_buf.retrieve(consumed);
+        if (consumed == 0) {
+            return false;
+        }
     }
+    return finish_body();
+}
+
 
-    content = content.substr(current_pos);
-    return HeaderState::PARSE_HEADER_AGAIN;
+bool HttpData::deliver_body(std::string_view data) {
+    m_body_received += data.size();
+    if (m_body_received > s_max_body_size) {
+        m_error = true;
+        handle_error(413, "Payload Too Large");
+        return false;
+    }
+    std::string unused;
+    if (!m_body_consumer(data, false, unused)) {
+        m_error = true;
+        handle_error(500, "Internal Server Error");
+        return false;
+    }
+    return true;
 }
 
 
-AnalysisState HttpData::analysis_request() {
-    if (m_method == HttpMethod::METHOD_POST) {
-        m_out_buf.clear();
-        handle_error(m_connfd, 403, "Forbidden Request.");
-        return AnalysisState::ANALYSIS_ERROR;
+bool HttpData::finish_body() {
+    std::string body;
+    bool ok = m_body_consumer(std::string_view(), true, body);
+    m_body_consumer = nullptr;
+    if (!ok) {
+        m_error = true;
+        handle_error(500, "Internal Server Error");
+        return false;
     }
+
+    std::string extra_header = "Content-Type: text/plain\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+    extra_header += "Server: Static Web Server\r\n";
+    append_response_head(HTTP_200_STATUS, std::string_view(), nullptr, extra_header);
+    append_output(body);
+    return true;
+}
+
+
+// 小文件的内容已经在内存中，和响应头一起发送。其余不拷贝到内存，在 handle_write 中由 sendfile 发送
+void HttpData::append_file_body(const FileCache::CachedFilePtr &file, size_t offset, size_t length) {
+    if (!file->content.empty()) {
+        append_output_view(std::string_view(file->content).substr(offset, length), file);
+    } else {
+        append_output_file(file, static_cast<off_t>(offset), length);
+    }
+}
+
+
+void HttpData::append_partial_content(const FileCache::CachedFilePtr &file, const ByteRanges &ranges) {
+    char buf[128];
+    std::string extra_header;
+
+    if (ranges.size() == 1) {
+        const ByteRange &range = ranges[0];
+        snprintf(buf, sizeof(buf), "Content-Range: bytes %zu-%zu/%zu\r\nContent-Length: %zu\r\n",
+                 range.offset, range.offset + range.length - 1, file->size, range.length);
+        extra_header += "Content-Type: " + file->mime_type + "\r\n";
+        extra_header += buf;
+        append_response_head(HTTP_206_STATUS, file->common_header, file, extra_header);
+        append_file_body(file, range.offset, range.length);
+        return;
+    }
+
+    // 每个区间前是分隔行和区间自己的头，Content-Length 需要先算出所有部分的长度
+    thread_local uint64_t t_boundary_seq = 0;
+    char boundary[32];
+    snprintf(boundary, sizeof(boundary), "%020lu", static_cast<unsigned long>(++t_boundary_seq));
+
+    std::string part_header;
+    auto format_part_header = [&](const ByteRange &range) {
+        snprintf(buf, sizeof(buf), "Content-Range: bytes %zu-%zu/%zu\r\n\r\n",
+                 range.offset, range.offset + range.length - 1, file->size);
+        part_header.clear();
+        part_header += "\r\n--";
+        part_header += boundary;
+        part_header += "\r\nContent-Type: " + file->mime_type + "\r\n";
+        part_header += buf;
+    };
+    std::string last_boundary = std::string("\r\n--") + boundary + "--\r\n";
+
+    size_t content_length = last_boundary.size();
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        format_part_header(ranges[i]);
+        content_length += part_header.size() + ranges[i].length;
+    }
+
+    extra_header += "Content-Type: multipart/byteranges; boundary=";
+    extra_header += boundary;
+    extra_header += "\r\nContent-Length: " + std::to_string(content_length) + "\r\n";
+    append_response_head(HTTP_206_STATUS, file->common_header, file, extra_header);
+
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        format_part_header(ranges[i]);
+        append_output(part_header);
+        append_file_body(file, ranges[i].offset, ranges[i].length);
+    }
+    append_output(last_boundary);
+}
+
+
+void HttpData::append_range_not_satisfiable(const FileCache::CachedFilePtr &file) {
+    std::string extra_header = "Content-Range: bytes */" + std::to_string(file->size) + "\r\n";
+    extra_header += "Content-Length: 0\r\n";
+    append_response_head(HTTP_416_STATUS, file->common_header, file, extra_header);
+}
+
+
+AnalysisState HttpData::analysis_request() {
     if (m_method == HttpMethod::METHOD_GET || m_method == HttpMethod::METHOD_HEAD) {
-        // response header
-        std::string header;
-        header += "HTTP/1.1 200 OK\r\n";
-        if (m_headers.find("Connection") != m_headers.end() 
-            && (m_headers["Connection"] == "keep-alive" ||
-                m_headers["Connection"] == "Keep-Alive")) {
+        std::string_view connection = m_parser.headers(m_in_buf.readable()).get("Connection");
+        if (HttpHeaders::equals_ignore_case(connection, "keep-alive")) {
             m_keep_alive = true;
-            header += "Connection: keep-alive\r\nKeep-Alive: timeout=" +
-                std::to_string(KEEP_ALIVE_TIME) + "\r\n";
         }
 
-        // find filetype
-        size_t dot_pos = m_filename.find('.');
-        std::string filetype;
-        if (dot_pos == std::string::npos) {
-            filetype = MimeType::get_mime_type("default");
-        } else {
-            filetype = MimeType::get_mime_type(m_filename.substr(dot_pos));
+        // 路径指向 m_in_buf，请求处理完之前有效。默认 index.html
+        std::string_view filename = m_parser.path(m_in_buf.readable());
+        if (filename.empty()) {
+            filename = "index.html";
         }
 
         // if filename for test
-        if (m_filename == "hellotest") {
-            m_out_buf = "HTTP/1.1 200 OK\r\nContent-type: text/plain\r\n";
-            m_out_buf += "Content-Length: 10\r\n\r\n";
-            m_out_buf += "Hello Test";
+        if (filename == "hellotest") {
+            append_output_view("HTTP/1.1 200 OK\r\nContent-type: text/plain\r\n");
+            append_output_view("Content-Length: 10\r\n\r\n");
+            append_output_view("Hello Test");
             return AnalysisState::ANALYSIS_SUCCESS;
         }
 
-        // find file
-        struct stat sbuf;
-        if (stat(m_filename.c_str(), &sbuf) < 0) {
-            header.clear();
-            handle_error(m_connfd, 404, "Not Found!");
-            return AnalysisState::ANALYSIS_ERROR;
+        // 注册的流式响应
+        if (!s_stream_routes.empty() && start_stream(filename)) {
+            return AnalysisState::ANALYSIS_SUCCESS;
         }
 
-        // header information for response
-        header += "Content-Type: " + filetype + "\r\n";
-        header += "Content-Length: " + std::to_string(sbuf.st_size) + "\r\n";
-        header += "Server: Static Web Server\r\n";
-        header += "\r\n";
+        // find file, 命中缓存时不需要 stat/open
+        FileCache::CachedFilePtr file = FileCache::instance().get(filename);
+        if (!file) {
+            handle_error(404, "Not Found!");
+            return AnalysisState::ANALYSIS_ERROR;
+        }
 
-        m_out_buf += header;
+        // 内容协商: 之后的条件请求和 Range 都针对选中的版本 (各自有 ETag)
+        file = select_encoding(filename, std::move(file));
 
-        if (m_method == HttpMethod::METHOD_HEAD) {
+        // 条件请求: 客户端缓存的版本仍然有效，只发送 304 响应头
+        if (is_not_modified(*file)) {
+            append_response_head(HTTP_304_STATUS, file->common_header, file);
             return AnalysisState::ANALYSIS_SUCCESS;
         }
 
-        // prepare file contents to send
-        int file_fd = open(m_filename.c_str(), O_RDONLY, 0);
-        if (file_fd < 0) {
-            m_out_buf.clear();
-            handle_error(m_connfd, 404, "Not Found!");
-            return AnalysisState::ANALYSIS_ERROR;
+        // Range 只用于 GET，无法解析的 Range 按完整文件响应
+        const HttpHeaders &headers = m_parser.headers(m_in_buf.readable());
+        if (m_method == HttpMethod::METHOD_GET && headers.contains("Range") && if_range_matches(*file)) {
+            ByteRanges ranges;
+            RangeState state = ranges.parse(headers.get("Range"), file->size);
+            if (state == RangeState::RANGE_SATISFIABLE) {
+                append_partial_content(file, ranges);
+                return AnalysisState::ANALYSIS_SUCCESS;
+            }
+            if (state == RangeState::RANGE_NOT_SATISFIABLE) {
+                append_range_not_satisfiable(file);
+                return AnalysisState::ANALYSIS_SUCCESS;
+            }
         }
 
-        // mmap file
-        void *mmap_file = mmap(nullptr, sbuf.st_size, PROT_READ, MAP_PRIVATE, file_fd, 0);
-        close(file_fd);
-        if (mmap_file == MAP_FAILED) {
-            munmap(mmap_file, sbuf.st_size);
-            m_out_buf.clear();
-            handle_error(m_connfd, 404, "Not Found!");
-            return AnalysisState::ANALYSIS_ERROR;
+        append_response_head(HTTP_200_STATUS, file->header, file);
+
+        if (m_method == HttpMethod::METHOD_HEAD) {
+            return AnalysisState::ANALYSIS_SUCCESS;
         }
 
-        char* file_addr = static_cast<char*>(mmap_file);
-        // string buf
-        m_out_buf += std::string(file_addr, sbuf.st_size);
-        munmap(file_addr, sbuf.st_size);
+        append_file_body(file, 0, file->size);
         return AnalysisState::ANALYSIS_SUCCESS;
     }
 
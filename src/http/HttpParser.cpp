@@ -0,0 +1,213 @@
+#include "HttpParser.h"
+#include "HttpScan.h"
+
+
+namespace {
+    // 行内不允许出现的控制字符(除了 '\t')，'\r' 和 '\n' 也在其中，一次扫描同时找到行尾并校验整行
+    const ScanRanges LINE_END_RANGES{"\000\010\012\037\177\177", 6};
+    // 请求头 key 的结束位置，':' 之前出现空白是错误的
+    const ScanRanges KEY_END_RANGES{"\t\t  ::", 6};
+
+    inline char to_lower(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    inline bool is_space(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    inline bool starts_with(std::string_view s, std::string_view prefix) {
+        return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+    }
+}  // namespace
+
+
+// ==========================================================================
+// HttpHeaders
+
+bool HttpHeaders::equals_ignore_case(std::string_view a, std::string_view b) noexcept {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (to_lower(a[i]) != to_lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool HttpHeaders::add(size_t key_off, size_t key_len, size_t value_off, size_t value_len) noexcept {
+    if (m_count >= MAX_FIELDS) {
+        return false;
+    }
+    m_fields[m_count++] = Field{
+        static_cast<uint32_t>(key_off), static_cast<uint32_t>(key_len),
+        static_cast<uint32_t>(value_off), static_cast<uint32_t>(value_len)};
+    return true;
+}
+
+
+std::string_view HttpHeaders::get(std::string_view key) const noexcept {
+    for (size_t i = 0; i < m_count; ++i) {
+        if (m_fields[i].key_len == key.size() && equals_ignore_case(this->key(i), key)) {
+            return value(i);
+        }
+    }
+    return {};
+}
+
+
+bool HttpHeaders::contains(std::string_view key) const noexcept {
+    for (size_t i = 0; i < m_count; ++i) {
+        if (m_fields[i].key_len == key.size() && equals_ignore_case(this->key(i), key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// ==========================================================================
+// HttpRequestParser
+
+void HttpRequestParser::reset() noexcept {
+    m_pos = 0;
+    m_scan_pos = 0;
+    m_method = HttpMethod::METHOD_GET;
+    m_version = HttpVersion::HTTP_11;
+    m_path_off = 0;
+    m_path_len = 0;
+    m_headers.clear();
+}
+
+
+size_t HttpRequestParser::find_line_end(std::string_view buf) noexcept {
+    if (m_scan_pos < m_pos) {
+        m_scan_pos = m_pos;
+    }
+    const char *begin = buf.data();
+    const char *end = begin + buf.size();
+    const char *p = find_char_in_ranges(begin + m_scan_pos, end, LINE_END_RANGES);
+    if (p == end) {
+        m_scan_pos = buf.size();
+        return std::string_view::npos;
+    }
+    if (*p == '\n') {
+        return p - begin;
+    }
+    if (*p == '\r') {
+        if (p + 1 == end) {
+            m_scan_pos = p - begin;
+            return std::string_view::npos;
+        }
+        if (p[1] == '\n') {
+            return p + 1 - begin;
+        }
+    }
+    return LINE_INVALID;
+}
+
+
+// 请求行: METHOD SP /path[?query] SP HTTP/1.x CRLF
+URIState HttpRequestParser::parse_request_line(std::string_view buf) noexcept {
+    m_headers.rebase(buf.data());
+
+    while (true) {
+        size_t lf = find_line_end(buf);
+        if (lf == std::string_view::npos) {
+            return buf.size() > MAX_REQUEST_HEADER_SIZE ? URIState::PARSE_URI_ERROR : URIState::PARSE_URI_AGAIN;
+        }
+        // 完整的请求行也受同样的长度限制，和数据是否分批到达无关
+        if (lf == LINE_INVALID || lf >= MAX_REQUEST_HEADER_SIZE) {
+            return URIState::PARSE_URI_ERROR;
+        }
+
+        size_t line_start = m_pos;
+        size_t line_end = (lf > line_start && buf[lf - 1] == '\r') ? lf - 1 : lf;
+        m_pos = lf + 1;
+        if (line_end == line_start) {  // 请求行之前的空行忽略
+            continue;
+        }
+
+        std::string_view line = buf.substr(line_start, line_end - line_start);
+        size_t method_len = 0;
+        if (starts_with(line, "GET ")) {
+            m_method = HttpMethod::METHOD_GET;
+            method_len = 4;
+        } else if (starts_with(line, "POST ")) {
+            m_method = HttpMethod::METHOD_POST;
+            method_len = 5;
+        } else if (starts_with(line, "HEAD ")) {
+            m_method = HttpMethod::METHOD_HEAD;
+            method_len = 5;
+        } else {
+            return URIState::PARSE_URI_ERROR;
+        }
+
+        size_t uri_end = line.find(' ', method_len);
+        if (uri_end == std::string_view::npos || line[method_len] != '/') {
+            return URIState::PARSE_URI_ERROR;
+        }
+        std::string_view uri = line.substr(method_len + 1, uri_end - method_len - 1);
+        size_t qmark_pos = uri.find('?');
+        m_path_off = static_cast<uint32_t>(line_start + method_len + 1);
+        m_path_len = static_cast<uint32_t>(qmark_pos == std::string_view::npos ? uri.size() : qmark_pos);
+
+        std::string_view version = line.substr(uri_end + 1);
+        if (version == "HTTP/1.1") {
+            m_version = HttpVersion::HTTP_11;
+        } else if (version == "HTTP/1.0") {
+            m_version = HttpVersion::HTTP_10;
+        } else {
+            return URIState::PARSE_URI_ERROR;
+        }
+
+        return URIState::PARSE_URI_SUCCESS;
+    }
+}
+
+
+// 请求头: key ":" OWS value OWS CRLF，以空行结束
+HeaderState HttpRequestParser::parse_headers(std::string_view buf) noexcept {
+    m_headers.rebase(buf.data());
+
+    while (true) {
+        size_t lf = find_line_end(buf);
+        if (lf == std::string_view::npos) {
+            return buf.size() > MAX_REQUEST_HEADER_SIZE ? HeaderState::PARSE_HEADER_ERROR
+                                                        : HeaderState::PARSE_HEADER_AGAIN;
+        }
+        if (lf == LINE_INVALID || lf >= MAX_REQUEST_HEADER_SIZE) {
+            return HeaderState::PARSE_HEADER_ERROR;
+        }
+
+        size_t line_start = m_pos;
+        size_t line_end = (lf > line_start && buf[lf - 1] == '\r') ? lf - 1 : lf;
+        m_pos = lf + 1;
+        if (line_end == line_start) {
+            return HeaderState::PARSE_HEADER_SUCCESS;
+        }
+
+        std::string_view line = buf.substr(line_start, line_end - line_start);
+        const char *key_end = find_char_in_ranges(line.data(), line.data() + line.size(), KEY_END_RANGES);
+        if (key_end == line.data() + line.size() || *key_end != ':' || key_end == line.data()) {
+            return HeaderState::PARSE_HEADER_ERROR;
+        }
+        size_t colon = key_end - line.data();
+
+        size_t value_start = colon + 1;
+        size_t value_end = line.size();
+        while (value_start < value_end && is_space(line[value_start])) {
+            ++value_start;
+        }
+        while (value_end > value_start && is_space(line[value_end - 1])) {
+            --value_end;
+        }
+
+        if (!m_headers.add(line_start, colon, line_start + value_start, value_end - value_start)) {
+            return HeaderState::PARSE_HEADER_ERROR;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#include <charconv>
+
+#include "HttpParser.h"
+#include "HttpRange.h"
+
+
+namespace {
+    inline bool is_space(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    std::string_view trim(std::string_view s) {
+        while (!s.empty() && is_space(s.front())) {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && is_space(s.back())) {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    // 只接受十进制数字，不接受符号和空串，溢出返回 false
+    bool parse_size(std::string_view s, size_t &value) {
+        if (s.empty()) {
+            return false;
+        }
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+        return ec == std::errc() && end == s.data() + s.size();
+    }
+}  // namespace
+
+
+RangeState ByteRanges::parse(std::string_view value, size_t file_size) noexcept {
+    m_count = 0;
+
+    value = trim(value);
+    size_t eq_pos = value.find('=');
+    if (eq_pos == std::string_view::npos || !HttpHeaders::equals_ignore_case(trim(value.substr(0, eq_pos)), "bytes")) {
+        return RangeState::RANGE_NONE;
+    }
+    value.remove_prefix(eq_pos + 1);
+
+    bool has_spec = false;
+    size_t total = 0;
+    while (!value.empty()) {
+        size_t comma_pos = value.find(',');
+        std::string_view spec = trim(value.substr(0, comma_pos));
+        value.remove_prefix(comma_pos == std::string_view::npos ? value.size() : comma_pos + 1);
+        if (spec.empty()) {   // 列表中允许空元素
+            continue;
+        }
+        has_spec = true;
+
+        size_t dash_pos = spec.find('-');
+        if (dash_pos == std::string_view::npos) {
+            return RangeState::RANGE_NONE;
+        }
+        std::string_view first = trim(spec.substr(0, dash_pos));
+        std::string_view last = trim(spec.substr(dash_pos + 1));
+
+        ByteRange range{};
+        if (first.empty()) {
+            // "-500": 最后 500 字节
+            size_t suffix = 0;
+            if (!parse_size(last, suffix)) {
+                return RangeState::RANGE_NONE;
+            }
+            if (suffix == 0 || file_size == 0) {
+                continue;
+            }
+            range.offset = suffix < file_size ? file_size - suffix : 0;
+            range.length = file_size - range.offset;
+        } else {
+            size_t first_pos = 0;
+            size_t last_pos = file_size;
+            if (!parse_size(first, first_pos) || (!last.empty() && !parse_size(last, last_pos))) {
+                return RangeState::RANGE_NONE;
+            }
+            if (!last.empty() && last_pos < first_pos) {
+                return RangeState::RANGE_NONE;
+            }
+            if (first_pos >= file_size) {
+                continue;
+            }
+            // 超出文件的部分截断到文件末尾
+            if (last.empty() || last_pos >= file_size) {
+                last_pos = file_size - 1;
+            }
+            range.offset = first_pos;
+            range.length = last_pos - first_pos + 1;
+        }
+
+        total += range.length;
+        if (m_count == MAX_RANGES || total > file_size) {
+            m_count = 0;
+            return RangeState::RANGE_NONE;
+        }
+        m_ranges[m_count++] = range;
+    }
+
+    if (!has_spec) {
+        return RangeState::RANGE_NONE;
+    }
+    return m_count > 0 ? RangeState::RANGE_SATISFIABLE : RangeState::RANGE_NOT_SATISFIABLE;
+}
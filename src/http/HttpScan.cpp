@@ -0,0 +1,120 @@
+#include "HttpScan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCAN_X86 1
+#endif
+
+
+namespace {
+    const char *find_scalar(const char *p, const char *end, const ScanRanges &ranges) {
+        for (; p < end; ++p) {
+            if (ranges.table[static_cast<unsigned char>(*p)]) {
+                return p;
+            }
+        }
+        return end;
+    }
+
+#ifdef HTTP_SCAN_X86
+    // picohttpparser 的做法: pcmpestri 的 range 模式，一条指令比较 16 字节和最多 8 个区间
+    __attribute__((target("sse4.2")))
+    const char *find_sse42(const char *p, const char *end, const ScanRanges &ranges) {
+        __m128i ranges16 = _mm_load_si128(reinterpret_cast<const __m128i *>(ranges.bytes));
+        while (end - p >= 16) {
+            __m128i b16 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            int r = _mm_cmpestri(
+                ranges16, ranges.size, b16, 16, _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+            if (r != 16) {
+                return p + r;
+            }
+            p += 16;
+        }
+        return find_scalar(p, end, ranges);
+    }
+
+    // AVX2 没有 pcmpestri，用无符号 min/max 比较实现 lo <= c <= hi，一次处理 32 字节
+    __attribute__((target("avx2")))
+    const char *find_avx2(const char *p, const char *end, const ScanRanges &ranges) {
+        __m256i lo[8], hi[8];
+        int pairs = ranges.size / 2;
+        for (int i = 0; i < pairs; ++i) {
+            lo[i] = _mm256_set1_epi8(ranges.bytes[2 * i]);
+            hi[i] = _mm256_set1_epi8(ranges.bytes[2 * i + 1]);
+        }
+
+        while (end - p >= 32) {
+            __m256i b32 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i hit = _mm256_setzero_si256();
+            for (int i = 0; i < pairs; ++i) {
+                __m256i ge_lo = _mm256_cmpeq_epi8(_mm256_max_epu8(b32, lo[i]), b32);
+                __m256i le_hi = _mm256_cmpeq_epi8(_mm256_min_epu8(b32, hi[i]), b32);
+                hit = _mm256_or_si256(hit, _mm256_and_si256(ge_lo, le_hi));
+            }
+            auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return find_scalar(p, end, ranges);
+    }
+#endif
+
+    ScanBackend select_backend() {
+#ifdef HTTP_SCAN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return {find_avx2, "avx2"};
+        }
+        if (__builtin_cpu_supports("sse4.2")) {
+            return {find_sse42, "sse4.2"};
+        }
+#endif
+        return {find_scalar, "scalar"};
+    }
+
+    const ScanBackend backend = select_backend();
+}  // namespace
+
+
+ScanRanges::ScanRanges(const char *ranges, int ranges_size) : size(ranges_size) {
+    for (int i = 0; i < ranges_size && i < 16; i += 2) {
+        bytes[i] = ranges[i];
+        bytes[i + 1] = ranges[i + 1];
+        auto lo = static_cast<unsigned char>(ranges[i]);
+        auto hi = static_cast<unsigned char>(ranges[i + 1]);
+        for (unsigned c = lo; c <= hi; ++c) {
+            table[c] = true;
+        }
+    }
+}
+
+
+const char *find_char_in_ranges(const char *p, const char *end, const ScanRanges &ranges) {
+    // 短输入直接查表，避免向量初始化的开销
+    if (end - p < 16) {
+        return find_scalar(p, end, ranges);
+    }
+    return backend.find(p, end, ranges);
+}
+
+
+const char *scan_backend_name() {
+    return backend.name;
+}
+
+
+std::vector<ScanBackend> scan_backends() {
+    std::vector<ScanBackend> backends{{find_scalar, "scalar"}};
+#ifdef HTTP_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        backends.push_back({find_sse42, "sse4.2"});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        backends.push_back({find_avx2, "avx2"});
+    }
+#endif
+    return backends;
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <cerrno>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include "FileCache.h"
+#include "GzipCache.h"
+#include "HttpData.h"
+#include "Logger.h"
+#include "Precompressor.h"
+#include "Utils.h"
+
+
+namespace {
+    bool ends_with(const std::string &s, std::string_view suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+#ifdef HAVE_ZLIB
+    // 离线生成，使用最高压缩级别
+    bool compress_gzip(const std::string &input, std::string &output) {
+        return GzipCache::compress(input, output, 9);
+    }
+#endif
+
+#ifdef HAVE_BROTLI
+    bool compress_brotli(const std::string &input, std::string &output) {
+        size_t output_size = BrotliEncoderMaxCompressedSize(input.size());
+        if (output_size == 0) {
+            return false;
+        }
+        output.resize(output_size);
+        BROTLI_BOOL ok = BrotliEncoderCompress(
+            BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+            input.size(), reinterpret_cast<const uint8_t *>(input.data()),
+            &output_size, reinterpret_cast<uint8_t *>(output.data()));
+        output.resize(output_size);
+        return ok == BROTLI_TRUE;
+    }
+#endif
+
+    // 写临时文件后 rename，服务中的请求不会读到写了一半的文件
+    bool write_encoded(const std::string &path, const struct stat &source, std::string &data) {
+        std::string tmp_path = path + ".tmp";
+        int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            perror("Precompressor open failed.");
+            return false;
+        }
+        bool ok = writen(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+        // 和原文件相同的修改时间，原文件再修改后就能判断出过期
+        struct timespec times[2] = {source.st_atim, source.st_mtim};
+        ok = ok && futimens(fd, times) == 0;
+        close(fd);
+        if (!ok || rename(tmp_path.c_str(), path.c_str()) < 0) {
+            perror("Precompressor write failed.");
+            unlink(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+}  // namespace
+
+
+Precompressor::Precompressor(std::string root) : m_root(std::move(root)) {}
+
+
+void Precompressor::start() {
+    m_thread.start();
+}
+
+
+void Precompressor::thread_func() {
+    int compressed = 0;
+    walk(m_root, compressed);
+    LOG << "Precompressor: " << compressed << " files compressed under " << m_root;
+}
+
+
+// 跳过隐藏文件和符号链接，不跟随目录的链接
+void Precompressor::walk(const std::string &dir, int &compressed) {
+    DIR *dirp = opendir(dir.c_str());
+    if (dirp == nullptr) {
+        perror("Precompressor opendir failed.");
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dirp)) != nullptr) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = dir + "/" + entry->d_name;
+        struct stat sbuf;
+        if (lstat(path.c_str(), &sbuf) < 0) {
+            continue;
+        }
+        if (S_ISDIR(sbuf.st_mode)) {
+            walk(path, compressed);
+        } else if (S_ISREG(sbuf.st_mode)) {
+            compressed += compress_file(path);
+        }
+    }
+    closedir(dirp);
+}
+
+
+int Precompressor::compress_file(const std::string &path) {
+    for (std::string_view suffix: CONTENT_ENCODING_SUFFIXES) {
+        if (ends_with(path, suffix)) {
+            return 0;
+        }
+    }
+    // 只处理 MimeType 中有的可压缩类型，日志等未知类型不处理
+    size_t dot_pos = path.rfind('.');
+    if (dot_pos == std::string::npos || path.find('/', dot_pos) != std::string::npos
+        || !MimeType::contains(path.substr(dot_pos))
+        || !FileCache::is_compressible(FileCache::find_mime_type(path))) {
+        return 0;
+    }
+
+    struct stat sbuf;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &sbuf) < 0 || static_cast<size_t>(sbuf.st_size) < PRECOMPRESS_MIN_SIZE
+        || static_cast<size_t>(sbuf.st_size) > PRECOMPRESS_MAX_SIZE) {
+        close(fd);
+        return 0;
+    }
+
+    std::string input;
+    int compressed = 0;
+    for (size_t i = 0; i < CONTENT_ENCODING_COUNT; ++i) {
+        bool (*encoder)(const std::string &, std::string &) = nullptr;
+#ifdef HAVE_ZLIB
+        if (CONTENT_ENCODING_NAMES[i] == "gzip") {
+            encoder = compress_gzip;
+        }
+#endif
+#ifdef HAVE_BROTLI
+        if (CONTENT_ENCODING_NAMES[i] == "br") {
+            encoder = compress_brotli;
+        }
+#endif
+        if (encoder == nullptr) {
+            continue;
+        }
+
+        std::string encoded_path = path;
+        encoded_path.append(CONTENT_ENCODING_SUFFIXES[i]);
+        struct stat encoded_sbuf;
+        if (stat(encoded_path.c_str(), &encoded_sbuf) == 0 && FileCache::is_encoded_fresh(sbuf, encoded_sbuf)) {
+            continue;
+        }
+
+        if (input.empty()) {
+            input.resize(static_cast<size_t>(sbuf.st_size));
+            if (readn(fd, input.data(), input.size()) != static_cast<ssize_t>(input.size())) {
+                break;
+            }
+        }
+
+        // 压缩后没有变小的不保存
+        std::string output;
+        if (encoder(input, output) && output.size() < input.size() && write_encoded(encoded_path, sbuf, output)) {
+            ++compressed;
+        }
+    }
+    close(fd);
+
+    if (compressed > 0) {
+        FileCache::instance().invalidate(path);
+    }
+    return compressed;
+}
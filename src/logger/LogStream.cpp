@@ -39,6 +39,11 @@ LogStream& LogStream::operator<<(const std::string& str) {
     return *this;
 }
 
+LogStream& LogStream::operator<<(std::string_view str) {
+    m_buffer.append(str.data(), str.size());
+    return *this;
+}
+
 LogStream& LogStream::operator<<(short val) {
     return operator<<(static_cast<int>(val));
 }
@@ -1,9 +1,8 @@
 #include <cassert>
-#include <ctime>
 #include <iostream>
-#include <sys/time.h>
 
 #include "AsyncLogging.h"
+#include "Clock.h"
 #include "Logger.h"
 #include "ReadConfig.h"
 
@@ -51,16 +50,9 @@ Logger::Impl::Impl(const char* code_filename, int line)
 }
 
 
+// loop 线程中使用本轮循环缓存的时间，每秒只格式化一次
 void Logger::Impl::print_format_time() {
-    struct timeval tv;
-    time_t time;
-    
-    gettimeofday(&tv, nullptr);
-    time = tv.tv_sec;
-    struct tm* p_tm = localtime(&time);
-    
-    char time_str[32] = {0};
-    (void)strftime(time_str, 32, "%Y-%m-%d %H:%M:%S \n", p_tm);
-
-    m_stream << time_str;
+    std::string_view time_str = Clock::log_time();
+    m_stream.append(time_str.data(), time_str.size());
+    m_stream << " \n";
 }
\ No newline at end of file
@@ -5,7 +5,12 @@
 #include <string>
 
 #include "EventLoop.h"
+#include "FileCache.h"
+#include "GzipCache.h"
+#include "HttpData.h"
+#include "BodySpool.h"
 #include "Logger.h"
+#include "Precompressor.h"
 #include "ReadConfig.h"
 #include "Server.h"
 #include "Debug.h"
@@ -16,6 +21,12 @@ int main(int argc, char* argv[]) {
     int port = get_port();
     char logfile[32];
     get_logfile(logfile);
+    char dispatch_policy[32];
+    get_dispatch_policy(dispatch_policy, sizeof(dispatch_policy));
+    char poller_backend[32];
+    get_poller_backend(poller_backend, sizeof(poller_backend));
+    char body_spool_dir[256];
+    get_body_spool_dir(body_spool_dir, sizeof(body_spool_dir));
 
     int opt;
     const char* prompts = "n:l:p:";
@@ -43,11 +54,68 @@ int main(int argc, char* argv[]) {
     }
 
     Logger::set_log_file_name(std::string(logfile));
+
+    FileCache::instance().set_capacity(get_filecache_size());
+    FileCache::instance().set_revalidate_interval(get_filecache_revalidate_ms());
+    GzipCache::instance().set_enabled(get_gzip() != 0);
+    GzipCache::instance().set_capacity(static_cast<size_t>(get_gzip_cache_size()) * 1024 * 1024);
+    GzipCache::instance().set_budget(static_cast<size_t>(get_gzip_budget()) * 1024);
     
+    // 所有 EventLoop 的 Poller 都按这个后端创建
+    Poller::set_default_backend(Poller::parse_backend(poller_backend));
+    HttpData::set_oneshot(get_oneshot() != 0);
+    HttpData::set_max_body_size(static_cast<size_t>(get_body_max_size()) * 1024);
+
+    // 静态文件目录是当前目录，预压缩在后台进行，不影响启动
+    Precompressor precompressor(".");
+    if (get_precompress() != 0) {
+        precompressor.start();
+    }
+
     // init main loop
     EventLoop main_loop;
     // init server
-    Server server(&main_loop, nthread, port);
+    Server server(&main_loop, nthread, port, get_reuseport() != 0);
+    server.set_dispatch_policy(EventLoopThreadPool::parse_dispatch_policy(dispatch_policy));
+
+    // 上传示例: 请求体超过阈值后写入临时文件，响应接收到的大小。
+    // 任何客户端都可以上传，需要在配置中打开，默认没有接收请求体的路由，POST 都返回 403
+    if (get_upload() != 0) {
+        size_t body_spool_threshold = static_cast<size_t>(get_body_spool_threshold()) * 1024;
+        std::string spool_dir = body_spool_dir;
+        HttpData::register_body_handler("upload", [body_spool_threshold, spool_dir]() -> HttpData::BodyConsumer {
+            auto spool = std::make_shared<BodySpool>(body_spool_threshold, spool_dir);
+            return [spool](std::string_view data, bool last, std::string &response) -> bool {
+                if (!last) {
+                    return spool->append(data);
+                }
+                response = "received " + std::to_string(spool->size()) + " bytes";
+                response += spool->spooled() ? " (spooled to file)\n" : "\n";
+                return true;
+            };
+        });
+    }
+
+    // 状态页，长度未知，用流式响应每次生成一个 loop 的统计。页面公开内部统计，需要在配置中打开
+    if (get_server_status() != 0) {
+        HttpData::register_stream_handler("server-status", "text/plain", [&server]() -> HttpData::StreamProducer {
+            return [&server, index = size_t{0}](std::string &chunk) mutable -> bool {
+                const std::vector<EventLoop*> &loops = server.get_loops();
+                if (index == 0) {
+                    chunk += "FileCache hits: " + std::to_string(FileCache::instance().hits())
+                           + ", misses: " + std::to_string(FileCache::instance().misses()) + "\n";
+                    chunk += "GzipCache hits: " + std::to_string(GzipCache::instance().hits())
+                           + ", misses: " + std::to_string(GzipCache::instance().misses()) + "\n";
+                }
+                if (index < loops.size()) {
+                    chunk += "loop " + std::to_string(index)
+                           + ": connections " + std::to_string(loops[index]->get_connection_count())
+                           + ", pending bytes " + std::to_string(loops[index]->get_pending_bytes()) + "\n";
+                }
+                return ++index < loops.size();
+            };
+        });
+    }
     // start server
     PRINT("start server...");
     server.start();
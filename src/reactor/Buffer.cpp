@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Buffer.h"
+
+
+// ==========================================================================
+// Buffer
+
+Buffer::~Buffer() {
+    release_block();
+}
+
+
+void Buffer::append(std::string_view data) {
+    ensure_writable(data.size());
+    memcpy(begin_write(), data.data(), data.size());
+    has_written(data.size());
+}
+
+
+void Buffer::prepend(const void *data, size_t len) noexcept {
+    assert(len <= prependable_bytes());
+    m_read_index -= len;
+    memcpy(m_data + m_read_index, data, len);
+}
+
+
+void Buffer::ensure_writable(size_t len) {
+    if (m_data == nullptr || writable_bytes() < len) {
+        make_space(len);
+    }
+    assert(writable_bytes() >= len);
+}
+
+
+void Buffer::make_space(size_t len) {
+    size_t readable = readable_bytes();
+
+    // 前面已读的空间足够时，把未读数据移到开头，不重新分配
+    if (m_data != nullptr && writable_bytes() + prependable_bytes() >= len + CHEAP_PREPEND) {
+        memmove(m_data + CHEAP_PREPEND, peek(), readable);
+        m_read_index = CHEAP_PREPEND;
+        m_write_index = CHEAP_PREPEND + readable;
+        return;
+    }
+
+    // 至少翻倍，连续追加时拷贝的总量是线性的
+    size_t size = std::max(CHEAP_PREPEND + readable + len, m_capacity * 2);
+    void *memory = m_pool != nullptr ? m_pool->allocate(size) : ::operator new(size);
+    auto *block = static_cast<char *>(memory);
+    if (readable > 0) {
+        memcpy(block + CHEAP_PREPEND, peek(), readable);
+    }
+    release_block();
+    m_data = block;
+    m_capacity = size;
+    m_read_index = CHEAP_PREPEND;
+    m_write_index = CHEAP_PREPEND + readable;
+}
+
+
+void Buffer::release_block() noexcept {
+    if (m_data != nullptr) {
+        if (m_pool != nullptr) {
+            m_pool->deallocate(m_data, m_capacity);
+        } else {
+            ::operator delete(m_data);
+        }
+    }
+    m_data = nullptr;
+    m_capacity = 0;
+    retrieve_all();
+}
+
+
+void Buffer::shrink_if_empty() noexcept {
+    if (empty()) {
+        release_block();
+    }
+}
+
+
+ssize_t Buffer::read_fd(int fd, bool &nodata, size_t max_bytes) {
+    char extra[EXTRA_READ_SIZE];
+    ssize_t total_read = 0;
+
+    if (m_data == nullptr) {
+        ensure_writable(INITIAL_SIZE);
+    }
+
+    while (static_cast<size_t>(total_read) < max_bytes) {
+        size_t writable = writable_bytes();
+        struct iovec vec[2];
+        vec[0].iov_base = begin_write();
+        vec[0].iov_len = writable;
+        vec[1].iov_base = extra;
+        vec[1].iov_len = sizeof(extra);
+
+        ssize_t nread = readv(fd, vec, 2);
+        if (nread < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                return total_read;
+            }
+            perror("Buffer::read_fd failed.");
+            return -1;
+        }
+        if (nread == 0) {
+            nodata = true;
+            break;
+        }
+
+        total_read += nread;
+        if (static_cast<size_t>(nread) <= writable) {
+            has_written(static_cast<size_t>(nread));
+        } else {
+            // 缓冲区写满，多出的部分在栈上，扩容后追加
+            m_write_index = m_capacity;
+            append(std::string_view(extra, static_cast<size_t>(nread) - writable));
+        }
+    }
+
+    return total_read;
+}
@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <cassert>
+
+#include "Channel.h"
+#include "ChannelTable.h"
+#include "HttpData.h"
+
+
+ChannelTable::Slot &ChannelTable::acquire(int fd) {
+    assert(fd >= 0);
+    auto page = static_cast<size_t>(fd) >> PAGE_BITS;
+    if (page >= m_pages.size()) {
+        m_pages.resize(page + 1);
+        m_page_generation.resize(page + 1, 0);
+    }
+    if (!m_pages[page]) {
+        m_pages[page] = m_spare_page ? std::move(m_spare_page) : std::make_unique<Page>();
+        for (Slot &slot: m_pages[page]->slots) {
+            slot.generation = m_page_generation[page];
+        }
+    }
+
+    Slot &slot = m_pages[page]->slots[static_cast<size_t>(fd) & PAGE_MASK];
+    if (!slot.in_use) {
+        slot.in_use = true;
+        ++m_pages[page]->in_use;
+    }
+    return slot;
+}
+
+
+void ChannelTable::release(int fd) {
+    Slot *slot = find(fd);
+    if (slot == nullptr || !slot->in_use) {
+        return;
+    }
+    assert(!slot->channel && !slot->http_data);
+    slot->in_use = false;
+
+    auto page = static_cast<size_t>(fd) >> PAGE_BITS;
+    if (--m_pages[page]->in_use > 0) {
+        return;
+    }
+    uint32_t generation = m_page_generation[page];
+    for (const Slot &s: m_pages[page]->slots) {
+        generation = std::max(generation, s.generation);
+    }
+    m_page_generation[page] = generation;
+    if (!m_spare_page) {
+        m_spare_page = std::move(m_pages[page]);
+    } else {
+        m_pages[page].reset();
+    }
+}
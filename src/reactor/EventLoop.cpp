@@ -2,6 +2,7 @@
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 
+#include "Clock.h"
 #include "EventLoop.h"
 #include "Logger.h"
 #include "Utils.h"
@@ -20,7 +21,7 @@ int create_eventfd() {
 }
 
 EventLoop::EventLoop()
-    : m_poller(new Epoll()), 
+    : m_poller(Poller::new_poller()), 
       m_wakeup_fd(create_eventfd()),
       m_thread_id(CurrentThread::get_tid()) 
 {
@@ -35,7 +36,7 @@ EventLoop::EventLoop()
     m_wakeup_channel->set_conn_handler([this]() {this->handle_connection();});
 
     // no timer
-    m_poller->epoll_add(m_wakeup_channel, 0);
+    m_poller->add_channel(m_wakeup_channel, 0);
 }
 
 
@@ -96,18 +97,6 @@ void EventLoop::wakeup() {
 // }
 
 
-// 重要！！！使用 pending 队列和 eventfd 异步唤醒，不阻塞 accept 建立连接的过程
-void EventLoop::queue_in_loop(Functor&& cb) {
-    {
-        MutexGuard lock(m_mutex);
-        m_pending_functors.emplace_back(std::move(cb));
-    }
-    if (!is_in_loop_thread() || m_is_calling_pending_functors) {
-        wakeup();
-    }
-}
-
-
 void EventLoop::loop() {
     assert(!m_is_looping);
     assert(is_in_loop_thread());
@@ -115,16 +104,19 @@ void EventLoop::loop() {
     m_is_looping = true;
     m_is_quit = false;
 
-    std::vector<std::shared_ptr<Channel>> active_channels;
     while (!m_is_quit) {
-        active_channels.clear();
+        // 上一轮的回调可能执行了很久，等待时长要按当前时间计算，否则会睡过到期的定时器
+        Clock::update();
         // 这一步将会把，epoll_wait 监控到的事件保存到 revents 中
-        active_channels = m_poller->get_active_events();
-        
+        m_poller->get_active_events(m_active_channels);
+        // 本轮中的定时器、日志和 Date 头都使用这个时间
+        Clock::update();
+
+
         // handle revents 处理
         m_is_event_handling = true;
-        for (auto& it: active_channels) {
-            it->handle_revents();
+        for (Channel* channel: m_active_channels) {
+            channel->handle_revents();
         }
         m_is_event_handling = false;
 
@@ -133,24 +125,22 @@ void EventLoop::loop() {
 
         // handle expired timers
         m_poller->handle_expired();
+
+        // 本轮关闭的连接，在所有回调结束之后才释放
+        m_poller->release_closed();
     }
 
     m_is_looping = false;
 }
 
 
+// 重要！！！使用 pending 队列和 eventfd 异步唤醒，不阻塞 accept 建立连接的过程
 void EventLoop::do_pending_functors() {
-    std::vector<Functor> functors;
     m_is_calling_pending_functors = true;
-    
-    {
-        MutexGuard lock(m_mutex);
-        functors.swap(m_pending_functors);
-    }
 
-    for (auto& functor: functors) {
-        functor();
-    }
+    // 先清除标志再取任务: 之后投递的任务要么这次被取到，要么它的生产者会再次唤醒
+    m_wakeup_pending.exchange(false, std::memory_order_acq_rel);
+    m_pending_tasks.run_all();
 
     m_is_calling_pending_functors = false;
 }
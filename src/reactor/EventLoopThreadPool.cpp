@@ -1,3 +1,6 @@
+#include <cstring>
+
+#include "EventLoop.h"
 #include "EventLoopThreadPool.h"
 #include "Debug.h"
 
@@ -25,18 +28,102 @@ void EventLoopThreadPool::start() {
 }
 
 
-// 从 EventLoop 线程池中，循环取出 EventLoop
-// 简单的 Round Robin
-EventLoop* EventLoopThreadPool::get_next_loop() {
+DispatchPolicy EventLoopThreadPool::parse_dispatch_policy(const char *name) {
+    if (name == nullptr || strcmp(name, "round_robin") == 0) {
+        return DispatchPolicy::ROUND_ROBIN;
+    }
+    if (strcmp(name, "least_conn") == 0) {
+        return DispatchPolicy::LEAST_CONN;
+    }
+    if (strcmp(name, "p2c_conn") == 0) {
+        return DispatchPolicy::P2C_CONN;
+    }
+    if (strcmp(name, "p2c_bytes") == 0) {
+        return DispatchPolicy::P2C_BYTES;
+    }
+    if (strcmp(name, "ip_hash") == 0) {
+        return DispatchPolicy::IP_HASH;
+    }
+    LOG << "Unknown dispatch policy " << name << ", use round_robin";
+    return DispatchPolicy::ROUND_ROBIN;
+}
+
+
+size_t EventLoopThreadPool::next_round_robin_index() {
+    size_t idx = m_next_idx;
+    m_next_idx = (m_next_idx + 1) % m_num_threads;
+    return idx;
+}
+
+
+// xorshift32
+size_t EventLoopThreadPool::random_index() {
+    m_random_state ^= m_random_state << 13;
+    m_random_state ^= m_random_state >> 17;
+    m_random_state ^= m_random_state << 5;
+    return m_random_state % m_evtloops.size();
+}
+
+
+template <typename Load>
+size_t EventLoopThreadPool::power_of_two_choices(Load load) {
+    size_t a = random_index();
+    size_t b = random_index();
+    if (a == b) {
+        b = (a + 1) % m_evtloops.size();
+    }
+    return load(m_evtloops[b]) < load(m_evtloops[a]) ? b : a;
+}
+
+
+// 从 EventLoop 线程池中取出 EventLoop，负载由各个 EventLoop 以原子变量发布
+EventLoop* EventLoopThreadPool::get_next_loop(uint32_t client_ip) {
     m_base_loop->assert_in_loop_thread();
     assert(m_started);
 
-    EventLoop* loop = m_base_loop;
-    if (!m_evtloops.empty()) {
-        loop = m_evtloops[m_next_idx];
-        PRINT("get event loop " << m_next_idx);
-        m_next_idx = (m_next_idx + 1) % m_num_threads;
+    if (m_evtloops.empty()) {
+        return m_base_loop;
+    }
+    if (m_evtloops.size() == 1) {
+        return m_evtloops[0];
+    }
+
+    size_t idx = 0;
+    switch (m_policy) {
+        case DispatchPolicy::LEAST_CONN: {
+            // 从轮转位置开始扫描，连接数相同时不总是选中第一个线程
+            idx = next_round_robin_index();
+            int min_conn = m_evtloops[idx]->get_connection_count();
+            for (size_t i = 1; i < m_evtloops.size(); ++i) {
+                size_t j = (idx + i) % m_evtloops.size();
+                int conn = m_evtloops[j]->get_connection_count();
+                if (conn < min_conn) {
+                    min_conn = conn;
+                    idx = j;
+                }
+            }
+            break;
+        }
+        case DispatchPolicy::P2C_CONN: {
+            idx = power_of_two_choices([](EventLoop *loop) { return loop->get_connection_count(); });
+            break;
+        }
+        case DispatchPolicy::P2C_BYTES: {
+            idx = power_of_two_choices([](EventLoop *loop) { return loop->get_pending_bytes(); });
+            break;
+        }
+        case DispatchPolicy::IP_HASH: {
+            // Fibonacci hashing，IPv4 地址的低位变化也能打散
+            idx = static_cast<size_t>((client_ip * 2654435761U) >> 16) % m_evtloops.size();
+            break;
+        }
+        case DispatchPolicy::ROUND_ROBIN:
+        default: {
+            idx = next_round_robin_index();
+            break;
+        }
     }
 
-    return loop;
+    PRINT("get event loop " << idx);
+    return m_evtloops[idx];
 }
@@ -0,0 +1,67 @@
+#include "CurrentThread.h"
+#include "MemoryPool.h"
+
+
+MemoryPool::MemoryPool() : m_owner_tid(CurrentThread::get_tid()) {}
+
+
+MemoryPool::~MemoryPool() {
+    for (FreeBlock *block: m_free) {
+        while (block != nullptr) {
+            FreeBlock *next = block->next;
+            ::operator delete(block);
+            block = next;
+        }
+    }
+}
+
+
+// 第一个不小于 size 的级别，超过最大级别时返回 MEMORYPOOL_CLASSES
+size_t MemoryPool::class_index(size_t size) noexcept {
+    size_t index = 0;
+    size_t class_size = MEMORYPOOL_MIN_BLOCK;
+    while (index < MEMORYPOOL_CLASSES && class_size < size) {
+        class_size <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+
+bool MemoryPool::in_owner_thread() const noexcept {
+    return CurrentThread::get_tid() == m_owner_tid;
+}
+
+
+void *MemoryPool::allocate(size_t &size) {
+    size_t index = class_index(size);
+    if (index == MEMORYPOOL_CLASSES) {
+        return ::operator new(size);
+    }
+
+    size = MEMORYPOOL_MIN_BLOCK << index;
+    FreeBlock *block = m_free[index];
+    if (block != nullptr && in_owner_thread()) {
+        m_free[index] = block->next;
+        m_cached_bytes -= size;
+        return block;
+    }
+    return ::operator new(size);
+}
+
+
+void MemoryPool::deallocate(void *block, size_t size) noexcept {
+    // 容器释放时给出的是请求的大小，按同样的方式取整到级别大小
+    size_t index = class_index(size);
+    if (index < MEMORYPOOL_CLASSES) {
+        size_t class_size = MEMORYPOOL_MIN_BLOCK << index;
+        if (m_cached_bytes + class_size <= MEMORYPOOL_MAX_CACHED_BYTES && in_owner_thread()) {
+            auto *free_block = static_cast<FreeBlock *>(block);
+            free_block->next = m_free[index];
+            m_free[index] = free_block;
+            m_cached_bytes += class_size;
+            return;
+        }
+    }
+    ::operator delete(block);
+}
@@ -0,0 +1,206 @@
+#include <cerrno>
+#include <cstring>
+
+#include "Epoll.h"
+#include "Logger.h"
+#include "Poller.h"
+#include "UringPoller.h"
+
+#include "Debug.h"
+
+
+const int EVENTS_NUM = 4096;
+const int EPOLLWAIT_TIME = 10'000;
+
+
+PollerBackend Poller::s_default_backend = PollerBackend::EPOLL;
+
+
+namespace {
+    // epoll_event.data 高 32 位是 generation，低 32 位是 fd
+    inline uint64_t pack_event_data(int fd, uint32_t generation) {
+        return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+    }
+}  // namespace
+
+
+Poller::Poller() : m_events_buf(EVENTS_NUM) {}
+
+
+std::unique_ptr<Poller> Poller::new_poller() {
+    if (s_default_backend == PollerBackend::IO_URING) {
+        std::unique_ptr<UringPoller> uring(new UringPoller());
+        if (uring->is_valid()) {
+            return uring;
+        }
+        LOG << "io_uring is not available, use epoll";
+    }
+    return std::unique_ptr<Poller>(new Epoll());
+}
+
+
+PollerBackend Poller::parse_backend(const char *name) {
+    if (name == nullptr || strcmp(name, "epoll") == 0) {
+        return PollerBackend::EPOLL;
+    }
+    if (strcmp(name, "io_uring") == 0) {
+        return PollerBackend::IO_URING;
+    }
+    LOG << "Unknown poller " << name << ", use epoll";
+    return PollerBackend::EPOLL;
+}
+
+
+// 每个一个连接描述符，对应一个 Channel，描述符由 epoll 监控
+// 每个 Channel 对应一个 HttpData 对象，Channel 作为 HttpData 的操作中间工具类
+// Channel 负责接口，HttpData 负责实际的数据处理逻辑
+void Poller::add_channel(std::shared_ptr<Channel> req_channel, int timeout) {
+    int fd = req_channel->get_fd();
+    ChannelTable::Slot &slot = m_channels.acquire(fd);
+    ++slot.generation;   // fd 可能被复用，旧连接遗留的事件据此丢弃
+
+    if (timeout > 0) {
+        add_timer(req_channel, timeout);
+        slot.http_data = req_channel->get_owner_http();
+    }
+
+    uint32_t events = req_channel->get_events();  // 注册 m_events 到 poller 中
+    // req_channel->updata_last_events();
+    req_channel->compare_and_updata_last_evt();
+
+    slot.channel = req_channel;
+    if (!backend_add(fd, events, pack_event_data(fd, slot.generation))) {
+        perror("poller add failed.");
+        slot.channel.reset();
+        slot.http_data.reset();
+        m_channels.release(fd);
+    }
+}
+
+
+void Poller::add_acceptor(std::shared_ptr<Channel> accept_channel) {
+    int fd = accept_channel->get_fd();
+    ChannelTable::Slot &slot = m_channels.acquire(fd);
+    ++slot.generation;
+    accept_channel->compare_and_updata_last_evt();
+    slot.channel = accept_channel;
+
+    uint64_t data = pack_event_data(fd, slot.generation);
+    if (backend_add_acceptor(fd, data)) {
+        return;
+    }
+    if (!backend_add(fd, accept_channel->get_events(), data)) {
+        perror("poller add acceptor failed.");
+        slot.channel.reset();
+        m_channels.release(fd);
+    }
+}
+
+
+void Poller::modify_channel(std::shared_ptr<Channel> req_channel, int timeout) {
+    if (timeout > 0) {
+        add_timer(req_channel, timeout);
+    }
+
+    int fd = req_channel->get_fd();
+    // events 会在 collect_active_channels 中更新，表示 Poller 已经处理了事件
+    // EPOLLONESHOT 的注册触发一次之后就失效，即使事件没有变化也要重新注册
+    bool changed = !req_channel->compare_and_updata_last_evt();
+    if (changed || (req_channel->get_events() & EPOLLONESHOT)) {
+        ChannelTable::Slot *slot = m_channels.find(fd);
+        if (slot == nullptr) {
+            return;
+        }
+        // 修改之前注册的、还没有取出的事件，按过期事件丢弃
+        uint64_t old_data = pack_event_data(fd, slot->generation);
+        ++slot->generation;
+        if (!backend_mod(fd, req_channel->get_events(), pack_event_data(fd, slot->generation), old_data)) {
+           perror("poller mod failed.");
+           release_slot(fd, *slot);
+        }
+    }
+}
+
+
+void Poller::remove_channel(std::shared_ptr<Channel> req_channel) {
+    int fd = req_channel->get_fd();
+    ChannelTable::Slot *slot = m_channels.find(fd);
+    uint64_t data = pack_event_data(fd, slot != nullptr ? slot->generation : 0);
+
+    // 已将 m_events 保存到 m_lastevents
+    if (!backend_del(fd, req_channel->get_lastevents(), data)) {
+        perror("poller del failed.");
+    }
+    if (slot != nullptr) {
+        release_slot(fd, *slot);
+    }
+}
+
+
+// 可能正处于这个 Channel 自己的回调中，不能在这里析构。槽位所在的页可能随之释放
+void Poller::release_slot(int fd, ChannelTable::Slot &slot) {
+    if (slot.channel) {
+        m_closed_channels.emplace_back(std::move(slot.channel));
+    }
+    if (slot.http_data) {
+        m_closed_httpdata.emplace_back(std::move(slot.http_data));
+    }
+    m_channels.release(fd);
+}
+
+
+void Poller::release_closed() {
+    m_closed_httpdata.clear();
+    m_closed_channels.clear();
+}
+
+
+void Poller::get_active_events(std::vector<Channel*> &active_channels) {
+    active_channels.clear();
+    int timeout = m_timer_manager.next_timeout(EPOLLWAIT_TIME);
+    PRINT(backend_name() << " wait, events buf size " << m_events_buf.size() << " timeout " << timeout);
+    int event_count = backend_wait(timeout);
+    if (event_count < 0) {
+        if (errno != EINTR) {
+            perror("poller wait failed.");
+        }
+        return;
+    }
+    collect_active_channels(event_count, active_channels);
+}
+
+
+void Poller::collect_active_channels(int event_count, std::vector<Channel*> &active_channels) {
+    for (int i = 0; i < event_count; ++i) {
+        uint64_t data = m_events_buf[i].data.u64;
+        int fd = static_cast<int>(data & 0xFFFFFFFF);
+        ChannelTable::Slot *slot = m_channels.find(fd);
+        Channel *req_channel = slot != nullptr ? slot->channel.get() : nullptr;
+        PRINT("active fd: " << fd);
+        if (!req_channel) {
+            LOG << "Poller::get_active_channels: shared_ptr req_channel is nullptr.";
+        } else if (slot->generation != static_cast<uint32_t>(data >> 32)) {
+            LOG << "Poller::get_active_channels: stale event for fd " << fd;
+        } else {
+            // 活跃事件
+            req_channel->set_revents(m_events_buf[i].events);
+            req_channel->set_events(0);   // 已响应，重置
+            active_channels.push_back(req_channel);
+        }
+    }
+}
+
+
+void Poller::add_timer(std::shared_ptr<Channel> req_channel, int timeout) {
+    std::shared_ptr<HttpData> http_data = req_channel->get_owner_http();
+    if (http_data) {
+        m_timer_manager.add_timer(http_data->get_timer(), timeout);
+    } else {
+        LOG << "Poller::add_timer: shared_ptr http_data is nullptr.";
+    }
+}
+
+
+void Poller::handle_expired() {
+    m_timer_manager.handle_expired_event();
+}
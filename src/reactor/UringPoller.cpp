@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Logger.h"
+#include "UringPoller.h"
+
+#include "Debug.h"
+
+
+const unsigned URING_ENTRIES = 4096;
+const uint64_t URING_IGNORE_DATA = UINT64_MAX;   // POLL_REMOVE 自己的完成事件
+// fd 是非负的 int，data 低 32 位的最高位不会被使用，用来区分 accept 和 poll 的完成事件
+const uint64_t URING_ACCEPT_BIT = 1ULL << 31;
+
+
+namespace {
+    int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                           const void *arg, size_t arg_size) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+    }
+
+    unsigned load_acquire(const unsigned *p) {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+
+    void store_release(unsigned *p, unsigned v) {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+
+    void *ring_offset(void *base, uint32_t offset) {
+        return static_cast<char *>(base) + offset;
+    }
+}  // namespace
+
+
+UringPoller::UringPoller() {
+    if (!setup(URING_ENTRIES)) {
+        teardown();
+    }
+}
+
+
+UringPoller::~UringPoller() {
+    teardown();
+}
+
+
+bool UringPoller::setup(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // CQ 比 SQ 大: 一个 multishot poll 可以产生多个完成事件
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = entries * 4;
+    m_ring_fd = sys_io_uring_setup(entries, &params);
+    if (m_ring_fd < 0 && errno == EINVAL) {
+        // 旧内核不支持 SINGLE_ISSUER / COOP_TASKRUN
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        m_ring_fd = sys_io_uring_setup(entries, &params);
+    }
+    if (m_ring_fd < 0) {
+        perror("io_uring_setup failed.");
+        return false;
+    }
+
+    m_features = params.features;
+    // 等待需要 EXT_ARG 传入超时，NODROP 保证 CQ 满时完成事件不丢失
+    if (!(m_features & IORING_FEAT_EXT_ARG) || !(m_features & IORING_FEAT_NODROP)) {
+        LOG << "io_uring: kernel lacks IORING_FEAT_EXT_ARG or IORING_FEAT_NODROP";
+        return false;
+    }
+
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = m_features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+    }
+
+    m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     m_ring_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ring == MAP_FAILED) {
+        m_sq_ring = nullptr;
+        perror("io_uring mmap sq ring failed.");
+        return false;
+    }
+    if (single_mmap) {
+        m_cq_ring = m_sq_ring;
+    } else {
+        m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         m_ring_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ring == MAP_FAILED) {
+            m_cq_ring = nullptr;
+            perror("io_uring mmap cq ring failed.");
+            return false;
+        }
+    }
+
+    m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      m_ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        perror("io_uring mmap sqes failed.");
+        return false;
+    }
+    m_sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+    m_sq_head = static_cast<unsigned *>(ring_offset(m_sq_ring, params.sq_off.head));
+    m_sq_tail = static_cast<unsigned *>(ring_offset(m_sq_ring, params.sq_off.tail));
+    m_sq_mask = *static_cast<unsigned *>(ring_offset(m_sq_ring, params.sq_off.ring_mask));
+    m_sq_entries = params.sq_entries;
+    m_sq_local_tail = *m_sq_tail;
+    // SQE 按顺序使用，array 固定为恒等映射
+    auto *sq_array = static_cast<unsigned *>(ring_offset(m_sq_ring, params.sq_off.array));
+    for (unsigned i = 0; i < m_sq_entries; ++i) {
+        sq_array[i] = i;
+    }
+
+    m_cq_head = static_cast<unsigned *>(ring_offset(m_cq_ring, params.cq_off.head));
+    m_cq_tail = static_cast<unsigned *>(ring_offset(m_cq_ring, params.cq_off.tail));
+    m_cq_mask = *static_cast<unsigned *>(ring_offset(m_cq_ring, params.cq_off.ring_mask));
+    m_cqes = static_cast<struct io_uring_cqe *>(ring_offset(m_cq_ring, params.cq_off.cqes));
+
+    PRINT("io_uring ring fd " << m_ring_fd << " sq " << params.sq_entries << " cq " << params.cq_entries);
+    return true;
+}
+
+
+void UringPoller::teardown() {
+    if (m_sqes != nullptr) {
+        munmap(m_sqes, m_sqes_size);
+        m_sqes = nullptr;
+    }
+    if (m_cq_ring != nullptr && m_cq_ring != m_sq_ring) {
+        munmap(m_cq_ring, m_cq_ring_size);
+    }
+    m_cq_ring = nullptr;
+    if (m_sq_ring != nullptr) {
+        munmap(m_sq_ring, m_sq_ring_size);
+        m_sq_ring = nullptr;
+    }
+    if (m_ring_fd >= 0) {
+        close(m_ring_fd);
+        m_ring_fd = -1;
+    }
+}
+
+
+UringPoller::PollState &UringPoller::state_of(int fd) {
+    if (static_cast<size_t>(fd) >= m_poll_states.size()) {
+        m_poll_states.resize(static_cast<size_t>(fd) + 1024);
+    }
+    return m_poll_states[fd];
+}
+
+
+struct io_uring_sqe *UringPoller::get_sqe() {
+    if (m_sq_local_tail - load_acquire(m_sq_head) >= m_sq_entries) {
+        // 没有 SQPOLL，io_uring_enter 返回时内核已经取走了全部 SQE
+        if (enter(m_sq_local_tail - load_acquire(m_sq_head), 0, 0, 0) < 0) {
+            perror("io_uring_enter submit failed.");
+        }
+    }
+    struct io_uring_sqe *sqe = &m_sqes[m_sq_local_tail & m_sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ++m_sq_local_tail;
+    return sqe;
+}
+
+
+void UringPoller::arm_poll(int fd, uint32_t events, uint64_t data) {
+    PollState &state = state_of(fd);
+    // 没有需要等待的事件，不注册
+    if ((events & ~(EPOLLET | EPOLLONESHOT)) == 0) {
+        state = PollState();
+        return;
+    }
+
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events & ~EPOLLONESHOT;
+    sqe->user_data = data;
+    if (!(events & EPOLLONESHOT)) {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    state.data = data;
+    state.events = events;
+}
+
+
+void UringPoller::arm_accept(int fd, uint64_t data) {
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;   // 和 accept4 相同，TCP_NODELAY 从监听 socket 继承
+    sqe->user_data = data | URING_ACCEPT_BIT;
+
+    PollState &state = state_of(fd);
+    state.data = data;
+    state.events = EPOLLIN | EPOLLET;
+    state.accept = true;
+}
+
+
+void UringPoller::cancel_poll(PollState &state) {
+    if (state.data == 0) {
+        return;
+    }
+    // 还没有交给调用者的连接
+    for (int conn_fd: state.accepted) {
+        close(conn_fd);
+    }
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = state.accept ? IORING_OP_ASYNC_CANCEL : IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = state.accept ? (state.data | URING_ACCEPT_BIT) : state.data;
+    sqe->user_data = URING_IGNORE_DATA;
+    if (m_features & IORING_FEAT_CQE_SKIP) {
+        sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+    }
+    state = PollState();
+}
+
+
+bool UringPoller::backend_add(int fd, uint32_t events, uint64_t data) {
+    cancel_poll(state_of(fd));
+    arm_poll(fd, events, data);
+    return true;
+}
+
+
+// 单次 poll 触发之后已经结束，不需要取消；multishot 的取消和新的注册在同一次提交中按顺序执行
+bool UringPoller::backend_mod(int fd, uint32_t events, uint64_t data, uint64_t /*old_data*/) {
+    cancel_poll(state_of(fd));
+    arm_poll(fd, events, data);
+    return true;
+}
+
+
+bool UringPoller::backend_del(int fd, uint32_t /*events*/, uint64_t /*data*/) {
+    cancel_poll(state_of(fd));
+    return true;
+}
+
+
+bool UringPoller::backend_add_acceptor(int fd, uint64_t data) {
+    cancel_poll(state_of(fd));
+    arm_accept(fd, data);
+    return true;
+}
+
+
+bool UringPoller::take_accepted(int listen_fd, std::vector<int> &conn_fds) {
+    PollState &state = state_of(listen_fd);
+    conn_fds.insert(conn_fds.end(), state.accepted.begin(), state.accepted.end());
+    state.accepted.clear();
+    return state.accept;
+}
+
+
+bool UringPoller::complete_accept(int fd, uint64_t data, const struct io_uring_cqe &cqe) {
+    PollState &state = state_of(fd);
+    // 取消之后才完成的 accept，连接已经没有人处理
+    if (state.data != data || !state.accept) {
+        if (cqe.res >= 0) {
+            close(cqe.res);
+        }
+        return false;
+    }
+
+    // 每轮只通知一次，同一轮的连接在 take_accepted 中一起取出
+    bool notify = state.accepted.empty();
+    if (cqe.res >= 0) {
+        state.accepted.push_back(cqe.res);
+    }
+    if (cqe.flags & IORING_CQE_F_MORE) {
+        return notify && cqe.res >= 0;
+    }
+
+    if (cqe.res >= 0) {
+        // 内核结束了 multishot (比如 CQ 溢出)，重新提交
+        arm_accept(fd, data);
+        return notify;
+    }
+    // 内核不支持 multishot accept，或者 accept 出错 (比如 EMFILE)，
+    // 退回到 poll 就绪通知，由调用者 accept4，避免反复提交失败的 accept
+    LOG << "io_uring accept on fd " << fd << " failed: " << strerror(-cqe.res) << ", fall back to poll";
+    state.accept = false;
+    arm_poll(fd, EPOLLIN | EPOLLET, data);
+    return notify;
+}
+
+
+int UringPoller::enter(unsigned to_submit, unsigned min_complete, unsigned flags, int timeout) {
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    const void *arg_ptr = nullptr;
+    size_t arg_size = 0;
+
+    if ((flags & IORING_ENTER_GETEVENTS) && timeout > 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout % 1000) * 1'000'000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        arg.sigmask_sz = _NSIG / 8;
+        arg_ptr = &arg;
+        arg_size = sizeof(arg);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+
+    store_release(m_sq_tail, m_sq_local_tail);
+    int ret = sys_io_uring_enter(m_ring_fd, to_submit, min_complete, flags, arg_ptr, arg_size);
+    if (ret < 0 && errno == ETIME) {
+        return 0;   // 等待超时
+    }
+    return ret;
+}
+
+
+// 完成事件转成 epoll_event 写入 m_events_buf
+int UringPoller::reap_completions() {
+    int count = 0;
+    unsigned head = *m_cq_head;
+    unsigned tail = load_acquire(m_cq_tail);
+    while (head != tail && count < static_cast<int>(m_events_buf.size())) {
+        const struct io_uring_cqe &cqe = m_cqes[head & m_cq_mask];
+        ++head;
+
+        uint64_t data = cqe.user_data;
+        if (data == URING_IGNORE_DATA) {
+            continue;
+        }
+        if (data & URING_ACCEPT_BIT) {
+            data &= ~URING_ACCEPT_BIT;
+            auto listen_fd = static_cast<int>(data & 0xFFFFFFFF);
+            if (complete_accept(listen_fd, data, cqe)) {
+                m_events_buf[count].events = EPOLLIN;
+                m_events_buf[count].data.u64 = data;
+                ++count;
+            }
+            continue;
+        }
+        auto fd = static_cast<int>(data & 0xFFFFFFFF);
+        PollState &state = state_of(fd);
+        // 已经取消或修改的 poll 在取消生效之前的完成事件，直接丢弃
+        if (state.data != data) {
+            continue;
+        }
+        bool finished = !(cqe.flags & IORING_CQE_F_MORE);
+        uint32_t registered_events = state.events;
+        if (finished) {
+            state = PollState();
+        }
+
+        if (cqe.res < 0) {
+            // 被取消的 poll (-ECANCELED) 是正常情况
+            if (cqe.res != -ECANCELED) {
+                LOG << "io_uring poll on fd " << fd << " failed: " << strerror(-cqe.res);
+            }
+            continue;
+        }
+
+        m_events_buf[count].events = static_cast<uint32_t>(cqe.res);
+        m_events_buf[count].data.u64 = data;
+        ++count;
+
+        // multishot poll 可能被内核结束 (比如 CQ 溢出)，Channel 仍然需要这个注册，重新提交
+        if (finished && !(registered_events & EPOLLONESHOT)) {
+            arm_poll(fd, registered_events, data);
+        }
+    }
+    store_release(m_cq_head, head);
+    return count;
+}
+
+
+int UringPoller::backend_wait(int timeout) {
+    unsigned to_submit = m_sq_local_tail - load_acquire(m_sq_head);
+    bool has_completions = *m_cq_head != load_acquire(m_cq_tail);
+
+    // 已有完成事件时只提交，不等待。GETEVENTS 同时让内核处理延迟的完成 (COOP_TASKRUN)
+    if (!has_completions) {
+        if (enter(to_submit, timeout != 0 ? 1 : 0, IORING_ENTER_GETEVENTS, timeout) < 0) {
+            return -1;
+        }
+    } else if (to_submit > 0) {
+        if (enter(to_submit, 0, 0, 0) < 0) {
+            return -1;
+        }
+    }
+    return reap_completions();
+}
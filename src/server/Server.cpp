@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <arpa/inet.h>
+#include <array>
 #include <functional>
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -9,17 +11,58 @@
 #include "Debug.h"
 
 
-Server::Server(EventLoop* loop, int num_threads, int port)
-    : m_main_loop(loop), m_num_threads(num_threads), m_port(port)
+namespace {
+    // 在 loop 所属的线程中调用
+    void register_connection(EventLoop* loop, int conn_fd) {
+        // request_httpdata 对应某个 active_loop
+        // 向 active_loop 中注册 新的事件 ，默认为 EPOLLIN | EPOLLET | EPOLLONESHOT，或者持续注册的 EPOLLIN | EPOLLET
+        // HttpData 和 shared_ptr 的控制块在一次分配中完成，内存来自 loop 的 MemoryPool
+        std::shared_ptr<HttpData> request_httpdata =
+            std::allocate_shared<HttpData>(PoolAllocator<HttpData>(&loop->get_memory_pool()), loop, conn_fd);
+        request_httpdata->get_channel()->set_owner_http(request_httpdata);
+        request_httpdata->add_new_event();
+    }
+
+    // 一个任务携带的连接数。任务对象放得进 TaskNode 的内联空间，投递时不需要堆分配
+    constexpr int CONNECTION_BATCH_SIZE = 12;
+
+    struct ConnectionBatch {
+        EventLoop* loop{nullptr};
+        int count{0};
+        std::array<int, CONNECTION_BATCH_SIZE> fds{};
+    };
+    static_assert(sizeof(ConnectionBatch) <= TaskNode::INLINE_SIZE, "ConnectionBatch must fit in a TaskNode");
+
+    void post_batch(ConnectionBatch& batch) {
+        batch.loop->queue_in_loop([batch]() {
+            for (int i = 0; i < batch.count; ++i) {
+                register_connection(batch.loop, batch.fds[i]);
+            }
+        });
+        batch.count = 0;
+    }
+}  // namespace
+
+
+Server::Server(EventLoop* loop, int num_threads, int port, bool reuse_port)
+    : m_reuse_port(reuse_port), m_main_loop(loop), m_num_threads(num_threads), m_port(port)
 {
     m_evt_loop_th_pool = std::make_unique<EventLoopThreadPool>(m_main_loop, m_num_threads);
     m_accept_channel = std::make_shared<Channel>(m_main_loop);
-    m_listen_fd = socket_bind_listen(m_port);
     
     handle_sigpipe();  // ignore
 
-    if (set_socket_nonblock(m_listen_fd) < 0) {
-        perror("set_socket_nonblock failed.");
+    if (m_reuse_port) {
+        // 监听 socket 在 start 中为每个工作线程创建
+        m_listen_fd = -1;
+        PRINT("Listening on port: " << m_port << " with SO_REUSEPORT");
+        return;
+    }
+
+    // 非阻塞和 TCP_NODELAY 已经在 socket_bind_listen 中设置
+    m_listen_fd = socket_bind_listen(m_port);
+    if (m_listen_fd < 0) {
+        perror("socket_bind_listen failed.");
         abort();
     }
 
@@ -33,6 +76,12 @@ void Server::start() {
     // start thread pool
     m_evt_loop_th_pool->start();
 
+    if (m_reuse_port) {
+        start_reuseport_acceptors();
+        m_started = true;
+        return;
+    }
+
     // 主线程作为监听连接请求的线程，设置 m_events 初始值
     m_accept_channel->set_events(EPOLLIN | EPOLLET);
     // accept_channel 的事件回调函数
@@ -40,55 +89,132 @@ void Server::start() {
     m_accept_channel->set_conn_handler([this]() {this->handle_connect();});;
     
     // 添加到事件循环，进行监控
-    m_main_loop->add_to_poller(m_accept_channel, 0);
+    m_main_loop->add_acceptor_to_poller(m_accept_channel);
     
     m_started = true;
 }
 
 
+void Server::start_reuseport_acceptors() {
+    const std::vector<EventLoop*> &loops = m_evt_loop_th_pool->get_all_loops();
+    m_reuseport_channels.reserve(loops.size());
+    for (EventLoop* loop: loops) {
+        int listen_fd = socket_bind_listen(m_port, true);
+        if (listen_fd < 0) {
+            perror("socket_bind_listen with SO_REUSEPORT failed.");
+            abort();
+        }
+
+        auto accept_channel = std::make_shared<Channel>(loop, listen_fd);
+        accept_channel->set_events(EPOLLIN | EPOLLET);
+        // 回调在 loop 线程中执行，这时主线程可能还在向 m_reuseport_channels 添加元素，
+        // 所以每个回调持有自己的 Channel，不通过下标访问 vector。使用 weak_ptr 避免 Channel 持有自己
+        std::weak_ptr<Channel> weak_channel = accept_channel;
+        accept_channel->set_read_handler([this, loop, weak_channel]() {
+            if (auto channel = weak_channel.lock()) {
+                this->accept_connections(loop, *channel);
+            }
+        });
+        accept_channel->set_conn_handler([loop, weak_channel]() {
+            if (auto channel = weak_channel.lock()) {
+                loop->modify_poller(channel, 0);
+            }
+        });
+        m_reuseport_channels.push_back(accept_channel);
+
+        // Epoll 只能在自己的线程中操作
+        loop->queue_in_loop([loop, accept_channel]() {loop->add_acceptor_to_poller(accept_channel);});
+    }
+}
+
+
 void Server::handle_available_connfd() {
+    accept_connections(m_main_loop, *m_accept_channel);
+}
+
+
+void Server::accept_connections(EventLoop* accept_loop, Channel& accept_channel) {
+    int listen_fd = accept_channel.get_fd();
     struct sockaddr_in client_addr;
     bzero(&client_addr, sizeof(client_addr));
     socklen_t client_addr_len = sizeof(client_addr);
 
-    int conn_fd = 0;
-    // 由于是多线程，如果多个连接就绪，边缘触犯只会触发一次，accept只处理一个连接，
-    // TCP 就绪队列中的连接得不到处理，所以使用 while
-    while ((conn_fd = accept(m_listen_fd, (struct sockaddr*)&client_addr, 
-                            &client_addr_len)) > 0) 
-    {
+    // 本轮 accept 的连接按目标 EventLoop 分组，每个 EventLoop 每 CONNECTION_BATCH_SIZE 个连接投递一次任务
+    // SO_REUSEPORT 模式下多个线程同时 accept，每个线程复用自己的数组
+    thread_local std::vector<ConnectionBatch> batches;
+    batches.clear();
+
+    // client_addr 为 nullptr 时不知道对端地址
+    auto dispatch_connection = [this, accept_loop](int conn_fd, const struct sockaddr_in* client_addr) {
+        uint32_t client_ip = client_addr != nullptr ? client_addr->sin_addr.s_addr : 0;
         // active_loop 属于另一个线程，被好 wakeup 后会处理 queue 中的 callback
-        EventLoop* active_loop = m_evt_loop_th_pool->get_next_loop();
+        // SO_REUSEPORT 模式下连接就由 accept 它的线程处理
+        EventLoop* active_loop = m_reuse_port ? accept_loop : m_evt_loop_th_pool->get_next_loop(client_ip);
+
+        if (client_addr != nullptr) {
+            LOG << "New connection, fd = " << conn_fd << ", ip = " 
+                << inet_ntoa(client_addr->sin_addr)
+                << ", port = " << ntohs(client_addr->sin_port);
+            PRINT("New connection, fd = " << conn_fd << ", ip = " << inet_ntoa(client_addr->sin_addr));
+        } else {
+            LOG << "New connection, fd = " << conn_fd;
+            PRINT("New connection, fd = " << conn_fd);
+        }
 
-        LOG << "New connection, fd = " << conn_fd << ", ip = " 
-            << inet_ntoa(client_addr.sin_addr)
-            << ", port = " << ntohs(client_addr.sin_port);
-        
-        PRINT("New connection, fd = " << conn_fd << ", ip = " << inet_ntoa(client_addr.sin_addr));
+        // HttpData 在 active_loop 线程中创建，这里先计数，本轮后续的分发可以看到
+        active_loop->add_connection();
 
-        if (conn_fd >= MAXFDS) {
-            close(conn_fd);
-            continue;
+        if (active_loop == accept_loop) {
+            register_connection(active_loop, conn_fd);
+            return;
         }
 
-        if (set_socket_nonblock(conn_fd) < 0) {
-            LOG << "set_socket_nonblock failed.";
-            return;
+        auto batch = std::find_if(batches.begin(), batches.end(), 
+                                  [active_loop](const auto& b) { return b.loop == active_loop; });
+        if (batch == batches.end()) {
+            batch = batches.insert(batches.end(), ConnectionBatch{active_loop});
+        }
+        batch->fds[batch->count++] = conn_fd;
+        if (batch->count == CONNECTION_BATCH_SIZE) {
+            post_batch(*batch);
         }
+    };
+
+    // io_uring 的 multishot accept 已经 accept 的连接。完成事件中没有对端地址，
+    // 只有 ip_hash 需要时才用 getpeername 取
+    thread_local std::vector<int> accepted;
+    accepted.clear();
+    bool accepted_by_poller = accept_loop->take_accepted(listen_fd, accepted);
+    bool need_client_ip = !m_reuse_port && m_evt_loop_th_pool->get_dispatch_policy() == DispatchPolicy::IP_HASH;
+    for (int conn_fd: accepted) {
+        client_addr_len = sizeof(client_addr);
+        bool has_addr = need_client_ip 
+                        && getpeername(conn_fd, (struct sockaddr*)&client_addr, &client_addr_len) == 0;
+        dispatch_connection(conn_fd, has_addr ? &client_addr : nullptr);
+    }
 
-        set_socket_nodelay(conn_fd);
+    int conn_fd = 0;
+    // 由于是多线程，如果多个连接就绪，边缘触犯只会触发一次，accept只处理一个连接，
+    // TCP 就绪队列中的连接得不到处理，所以使用 while
+    // accept4 直接设置非阻塞和 close-on-exec，TCP_NODELAY 从监听 socket 继承，每个连接只有这一次系统调用
+    while (!accepted_by_poller 
+           && (conn_fd = accept4(listen_fd, (struct sockaddr*)&client_addr, 
+                                 &client_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC)) > 0) 
+    {
+        dispatch_connection(conn_fd, &client_addr);
+        client_addr_len = sizeof(client_addr);
+    }
 
-        // request_httpdata 对应某个 active_loop
-        // 向 active_loop 中注册 新的事件 ，默认为 EPOLLIN | EPOLLET | EPOLLONESHOT
-        std::shared_ptr<HttpData> request_httpdata(new HttpData(active_loop, conn_fd));
-        request_httpdata->get_channel()->set_owner_http(request_httpdata);
-        active_loop->queue_in_loop([request_httpdata]() {request_httpdata->add_new_event();});
+    for (ConnectionBatch& batch: batches) {
+        if (batch.count > 0) {
+            post_batch(batch);
+        }
     }
 
     // 这一步非常非常关键！BUG制造者！
-    // 由于在 Epoll::collect_active_channels 中重置了 events 为 0
+    // 由于在 Poller::collect_active_channels 中重置了 events 为 0
     // 需要重新设置注册事件为 EPOLLIN | EPOLLET，以继续监听网络连接
-    m_accept_channel->set_events(EPOLLIN | EPOLLET);
+    accept_channel.set_events(EPOLLIN | EPOLLET);
 }
 
 
@@ -0,0 +1,107 @@
+#include "TaskQueue.h"
+
+
+namespace {
+    // 生产者线程缓存的空闲节点，来自任意 TaskQueue，节点之间没有区别
+    struct TaskCache {
+        TaskNode *head{nullptr};
+
+        ~TaskCache() {
+            while (head != nullptr) {
+                TaskNode *next = head->m_free_next;
+                delete head;
+                head = next;
+            }
+        }
+    };
+
+    thread_local TaskCache t_task_cache;
+}  // namespace
+
+
+// ==========================================================================
+// MpscQueue
+
+MpscNode *MpscQueue::pop() noexcept {
+    MpscNode *tail = m_tail;
+    MpscNode *next = tail->m_next.load(std::memory_order_acquire);
+    if (tail == &m_stub) {
+        if (next == nullptr) {
+            return nullptr;
+        }
+        m_tail = next;
+        tail = next;
+        next = next->m_next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+        m_tail = next;
+        return tail;
+    }
+
+    // tail 是最后一个节点，或者有生产者还没有链接上
+    MpscNode *head = m_head.load(std::memory_order_acquire);
+    if (tail != head) {
+        return nullptr;
+    }
+    // 放回 stub，tail 才能被取出
+    push(&m_stub);
+    next = tail->m_next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+        m_tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+
+// ==========================================================================
+// TaskQueue
+
+TaskQueue::~TaskQueue() {
+    while (MpscNode *node = m_queue.pop()) {
+        auto *task = static_cast<TaskNode *>(node);
+        task->discard();
+        delete task;
+    }
+    TaskNode *free_list = m_free.exchange(nullptr, std::memory_order_acquire);
+    while (free_list != nullptr) {
+        TaskNode *next = free_list->m_free_next;
+        delete free_list;
+        free_list = next;
+    }
+}
+
+
+TaskNode *TaskQueue::allocate() {
+    TaskCache &cache = t_task_cache;
+    if (cache.head == nullptr && m_free.load(std::memory_order_relaxed) != nullptr) {
+        cache.head = m_free.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (cache.head == nullptr) {
+        return new TaskNode();
+    }
+    TaskNode *node = cache.head;
+    cache.head = node->m_free_next;
+    node->m_free_next = nullptr;
+    return node;
+}
+
+
+void TaskQueue::recycle(TaskNode *node) noexcept {
+    TaskNode *head = m_free.load(std::memory_order_relaxed);
+    do {
+        node->m_free_next = head;
+    } while (!m_free.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+
+size_t TaskQueue::run_all() {
+    size_t count = 0;
+    while (MpscNode *node = m_queue.pop()) {
+        auto *task = static_cast<TaskNode *>(node);
+        task->run();
+        recycle(task);
+        ++count;
+    }
+    return count;
+}
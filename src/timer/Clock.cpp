@@ -0,0 +1,120 @@
+#include <cstring>
+
+#include "Clock.h"
+
+
+namespace {
+    struct ClockCache {
+        bool cached{false};   // 调用过 update() 的线程才使用缓存
+
+        uint64_t monotonic_ms{0};
+        time_t wall_seconds{-1};
+
+        // 秒数变化时才重新格式化
+        time_t http_date_seconds{-1};
+        time_t log_time_seconds{-1};
+        char http_date[32]{};
+        char log_time[32]{};
+        size_t http_date_len{0};
+        size_t log_time_len{0};
+    };
+
+    thread_local ClockCache t_clock;
+
+    void refresh(ClockCache &cache) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        cache.monotonic_ms = static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1'000'000;
+
+        // 墙上时间只需要秒级精度，COARSE 版本更便宜
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        cache.wall_seconds = ts.tv_sec;
+    }
+
+    ClockCache &current() {
+        if (!t_clock.cached) {
+            refresh(t_clock);
+        }
+        return t_clock;
+    }
+}  // namespace
+
+
+void Clock::update() {
+    t_clock.cached = true;
+    refresh(t_clock);
+}
+
+
+void Clock::set_now_ms(uint64_t ms) {
+    ClockCache &cache = current();
+    cache.cached = true;
+    cache.monotonic_ms = ms;
+}
+
+
+uint64_t Clock::now_ms() {
+    return current().monotonic_ms;
+}
+
+
+time_t Clock::wall_seconds() {
+    return current().wall_seconds;
+}
+
+
+std::string_view Clock::http_date() {
+    ClockCache &cache = current();
+    if (cache.http_date_seconds != cache.wall_seconds) {
+        cache.http_date_len = format_http_date(cache.wall_seconds, cache.http_date, sizeof(cache.http_date));
+        cache.http_date_seconds = cache.wall_seconds;
+    }
+    return {cache.http_date, cache.http_date_len};
+}
+
+
+size_t Clock::format_http_date(time_t seconds, char *buf, size_t len) {
+    struct tm tm_buf;
+    gmtime_r(&seconds, &tm_buf);
+    return strftime(buf, len, "%a, %d %b %Y %H:%M:%S GMT", &tm_buf);
+}
+
+
+bool Clock::parse_http_date(std::string_view value, time_t &seconds) {
+    // IMF-fixdate, 以及接收方必须兼容的两种旧格式
+    static const char *const formats[] = {
+        "%a, %d %b %Y %H:%M:%S GMT",    // Sun, 06 Nov 1994 08:49:37 GMT
+        "%A, %d-%b-%y %H:%M:%S GMT",    // Sunday, 06-Nov-94 08:49:37 GMT
+        "%a %b %e %H:%M:%S %Y",         // Sun Nov  6 08:49:37 1994
+    };
+
+    char buf[64];
+    if (value.size() >= sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, value.data(), value.size());
+    buf[value.size()] = '\0';
+
+    for (const char *format: formats) {
+        struct tm tm_buf;
+        memset(&tm_buf, 0, sizeof(tm_buf));
+        const char *end = strptime(buf, format, &tm_buf);
+        if (end != nullptr && *end == '\0') {
+            seconds = timegm(&tm_buf);
+            return seconds != -1;
+        }
+    }
+    return false;
+}
+
+
+std::string_view Clock::log_time() {
+    ClockCache &cache = current();
+    if (cache.log_time_seconds != cache.wall_seconds) {
+        struct tm tm_buf;
+        localtime_r(&cache.wall_seconds, &tm_buf);
+        cache.log_time_len = strftime(cache.log_time, sizeof(cache.log_time), "%Y-%m-%d %H:%M:%S", &tm_buf);
+        cache.log_time_seconds = cache.wall_seconds;
+    }
+    return {cache.log_time, cache.log_time_len};
+}
@@ -1,72 +1,228 @@
+#include "Clock.h"
 #include "Timer.h"
 
 
 // ==========================================================================
 // TimerNode
 
-TimerNode::TimerNode(std::shared_ptr<HttpData> request_data_sp, int timeout)
-    : m_http_data_sp(request_data_sp) 
-{
-    struct timeval now;
-    gettimeofday(&now, nullptr);
-    m_expire_time = (now.tv_sec % 10'000 ) * 1000 + now.tv_usec / 1000 + timeout;
+void TimerNode::cancel() noexcept {
+    if (is_linked()) {
+        TimerManager::list_del(*this);
+        --m_manager->m_count;
+        m_manager = nullptr;
+    }
 }
 
 
-TimerNode::~TimerNode() {
-    if (m_http_data_sp) {
-        m_http_data_sp->handle_close();
+// ==========================================================================
+// TimerManager
+
+TimerManager::TimerManager() : m_current(Clock::now_ms()) {
+    for (auto &head: m_tv1) {
+        list_init(head);
+    }
+    for (auto &level: m_tvn) {
+        for (auto &head: level) {
+            list_init(head);
+        }
     }
 }
 
 
-TimerNode::TimerNode(const TimerNode &tn)
-    : m_http_data_sp(tn.m_http_data_sp), m_expire_time(tn.m_expire_time) {} 
+TimerManager::~TimerManager() {
+    // 节点可能比时间轮活得久，摘除后它们的析构就不会再访问这里
+    auto detach_all = [](TimerLink &head) {
+        while (head.m_next != &head) {
+            TimerNode *node = to_node(head.m_next);
+            list_del(*node);
+            node->m_manager = nullptr;
+        }
+    };
+    for (auto &head: m_tv1) {
+        detach_all(head);
+    }
+    for (auto &level: m_tvn) {
+        for (auto &head: level) {
+            detach_all(head);
+        }
+    }
+}
 
 
-void TimerNode::update(int timeout) {
-    struct timeval now;
-    gettimeofday(&now, nullptr);
-    m_expire_time = (now.tv_sec % 10'000 ) * 1000 + now.tv_usec / 1000 + timeout;
+void TimerManager::list_init(TimerLink &head) noexcept {
+    head.m_prev = &head;
+    head.m_next = &head;
 }
 
 
-bool TimerNode::is_valid() {
-    struct timeval now;
-    gettimeofday(&now, nullptr);
-    size_t temp = (now.tv_sec % 10'000 ) * 1000 + now.tv_usec / 1000;
-    if (temp < m_expire_time) {
-        return true;
-    }
-    this->set_deleted();
-    return false;
+void TimerManager::list_add_tail(TimerLink &head, TimerLink &node) noexcept {
+    node.m_prev = head.m_prev;
+    node.m_next = &head;
+    head.m_prev->m_next = &node;
+    head.m_prev = &node;
 }
 
 
-void TimerNode::invalidate_timer() {
-    m_http_data_sp.reset();
-    this->set_deleted();
+void TimerManager::list_del(TimerLink &node) noexcept {
+    node.m_prev->m_next = node.m_next;
+    node.m_next->m_prev = node.m_prev;
+    node.m_prev = nullptr;
+    node.m_next = nullptr;
 }
 
 
-// ==========================================================================
-// TimerManager
+// 把 from 中的全部节点移到空链表 to 中，from 置空
+void TimerManager::list_splice(TimerLink &from, TimerLink &to) noexcept {
+    if (from.m_next == &from) {
+        list_init(to);
+        return;
+    }
+    to.m_next = from.m_next;
+    to.m_prev = from.m_prev;
+    to.m_next->m_prev = &to;
+    to.m_prev->m_next = &to;
+    list_init(from);
+}
 
-void TimerManager::add_timer(const std::shared_ptr<HttpData>& request_data_sp, int timeout) {
-    TimerNodeSP new_node_sp(new TimerNode(request_data_sp, timeout));
-    m_timer_queue.push(new_node_sp);
-    request_data_sp->link_timer(new_node_sp);  // add link
+
+void TimerManager::add_timer(TimerNode &node, int timeout) {
+    node.cancel();
+
+    uint64_t now = Clock::now_ms();
+    // 时间轮空闲时直接跳到当前时间，不必逐个 tick 追赶
+    if (m_count == 0 && m_current < now) {
+        m_current = now;
+    }
+    node.m_expire_time = now + static_cast<uint64_t>(timeout > 0 ? timeout : 0);
+    node.m_manager = this;
+    internal_add(node);
+    ++m_count;
 }
 
 
-void TimerManager::handle_expired_event() {
-    while (!m_timer_queue.empty()) {
-        TimerNodeSP top_node_sp = m_timer_queue.top();
-        if (top_node_sp->is_deleted() || !top_node_sp->is_valid()) {
-            top_node_sp.reset();
-            m_timer_queue.pop();
+// 按距离到期的 tick 数选择层级，槽位由到期时间对应的位决定
+void TimerManager::internal_add(TimerNode &node) noexcept {
+    uint64_t expires = node.m_expire_time;
+    TimerLink *head;
+
+    if (expires < m_current) {
+        // 已经到期，放到下一个要处理的槽中
+        head = &m_tv1[m_current & TVR_MASK];
+    } else {
+        uint64_t idx = expires - m_current;
+        if (idx < TVR_SIZE) {
+            head = &m_tv1[expires & TVR_MASK];
+        } else if (idx < (1ULL << (TVR_BITS + TVN_BITS))) {
+            head = &m_tvn[0][(expires >> TVR_BITS) & TVN_MASK];
+        } else if (idx < (1ULL << (TVR_BITS + 2 * TVN_BITS))) {
+            head = &m_tvn[1][(expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK];
         } else {
+            if (idx > MAX_TIMEOUT) {
+                expires = m_current + MAX_TIMEOUT;
+                node.m_expire_time = expires;
+            }
+            head = &m_tvn[2][(expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK];
+        }
+    }
+    list_add_tail(*head, node);
+}
+
+
+// 把高层的一个槽重新分配到低层，返回槽号，为 0 时说明这一层也转完了一圈
+int TimerManager::cascade(int level, int index) noexcept {
+    TimerLink work;
+    list_splice(m_tvn[level][index], work);
+    while (work.m_next != &work) {
+        TimerNode *node = to_node(work.m_next);
+        list_del(*node);
+        internal_add(*node);
+    }
+    return index;
+}
+
+
+void TimerManager::run_timers(uint64_t now) {
+    while (m_current <= now) {
+        auto index = static_cast<int>(m_current & TVR_MASK);
+        if (index == 0) {
+            for (int level = 0; level < TVN_LEVELS; ++level) {
+                auto level_index = static_cast<int>((m_current >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK);
+                if (cascade(level, level_index) != 0) {
+                    break;
+                }
+            }
+        }
+        ++m_current;
+
+        // 回调中可能取消其他定时器 (也会从 work 中摘除) 或者重新添加自己
+        TimerLink work;
+        list_splice(m_tv1[index], work);
+        while (work.m_next != &work) {
+            TimerNode *node = to_node(work.m_next);
+            list_del(*node);
+            --m_count;
+            node->m_manager = nullptr;
+            if (node->m_callback) {
+                node->m_callback();
+            }
+        }
+    }
+}
+
+
+// tv1 中的槽对应确定的到期 tick，找到的第一个非空槽就是最早的到期时间。
+// 高层的槽只记录它被 cascade 到低层的时刻，那时再精确计算，最多多唤醒一次
+uint64_t TimerManager::next_expire_time() const noexcept {
+    uint64_t next = UINT64_MAX;
+    for (uint64_t i = 0; i < TVR_SIZE; ++i) {
+        const TimerLink &head = m_tv1[(m_current + i) & TVR_MASK];
+        if (head.m_next != &head) {
+            next = m_current + i;
             break;
         }
     }
-}
\ No newline at end of file
+
+    for (int level = 0; level < TVN_LEVELS; ++level) {
+        int shift = TVR_BITS + level * TVN_BITS;
+        uint64_t base = m_current >> shift;
+        // 与当前槽号相同的槽要等到这一层转完一圈
+        for (uint64_t k = 1; k <= TVN_SIZE; ++k) {
+            uint64_t cascade_time = (base + k) << shift;
+            if (cascade_time >= next) {
+                break;
+            }
+            const TimerLink &head = m_tvn[level][(base + k) & TVN_MASK];
+            if (head.m_next != &head) {
+                next = cascade_time;
+                break;
+            }
+        }
+    }
+    return next;
+}
+
+
+int TimerManager::next_timeout(int max_timeout) const noexcept {
+    if (m_count == 0) {
+        return max_timeout;
+    }
+    uint64_t next = next_expire_time();
+    uint64_t now = Clock::now_ms();
+    if (next <= now) {
+        return 0;
+    }
+    uint64_t wait = next - now;
+    return wait < static_cast<uint64_t>(max_timeout) ? static_cast<int>(wait) : max_timeout;
+}
+
+
+void TimerManager::handle_expired_event() {
+    uint64_t now = Clock::now_ms();
+    if (m_count == 0) {
+        if (m_current <= now) {
+            m_current = now + 1;
+        }
+        return;
+    }
+    run_timers(now);
+}
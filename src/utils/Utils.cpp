@@ -5,6 +5,7 @@
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -191,6 +192,79 @@ ssize_t writen(int fd, std::string &buff) {
 }
 
 
+// send file region [offset, offset + remain) from in_fd to out_fd, without copying to user space.
+// offset and remain are updated to the unsent part, so the caller can resume on EPOLLOUT.
+ssize_t sendfilen(int out_fd, int in_fd, off_t &offset, size_t &remain) {
+    ssize_t onetime_send = 0;
+    ssize_t total_send = 0;
+
+    while (remain > 0) {
+        onetime_send = sendfile(out_fd, in_fd, &offset, remain);
+        if (onetime_send < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                break;
+            }
+            perror("sendfilen failed.");
+            return -1;
+        }
+        if (onetime_send == 0) {  // file truncated, Content-Length can not be satisfied
+            return -1;
+        }
+
+        total_send += onetime_send;
+        remain -= onetime_send;
+    }
+
+    return total_send;
+}
+
+
+// gather write of several buffers with one sendmsg, partially sent iov entries are adjusted in place.
+// MSG_MORE tells TCP that more data follows (e.g. the file after the response header),
+// so the tail is not pushed out as a small segment even with TCP_NODELAY.
+ssize_t sendmsgn(int fd, struct iovec *iov, int iovcnt, bool more) {
+    ssize_t onetime_send = 0;
+    ssize_t total_send = 0;
+    int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+
+    while (iovcnt > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = static_cast<size_t>(iovcnt);
+
+        onetime_send = sendmsg(fd, &msg, flags);
+        if (onetime_send < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                break;
+            }
+            perror("sendmsgn failed.");
+            return -1;
+        }
+
+        total_send += onetime_send;
+        auto left = static_cast<size_t>(onetime_send);
+        while (iovcnt > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+
+    return total_send;
+}
+
+
 void handle_sigpipe() {
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
@@ -233,17 +307,24 @@ void shutdown_WR(int fd) {
 }
 
 
-int socket_bind_listen(int port) {
+// 监听 socket 是非阻塞的，并设置了 TCP_NODELAY，accept 得到的连接会继承 TCP_NODELAY
+int socket_bind_listen(int port, bool reuse_port) {
     if (port < 0 || port > 65535) { return -1; }
 
-    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    int listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (listenfd < 0) { return -1; }
 
+    set_socket_nodelay(listenfd);
+
     int en_reuse = 1;
     if (setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &en_reuse, sizeof(en_reuse)) < 0) {
         close(listenfd);
         return -1;
     }
+    if (reuse_port && setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &en_reuse, sizeof(en_reuse)) < 0) {
+        close(listenfd);
+        return -1;
+    }
 
     struct sockaddr_in servaddr;
     bzero(&servaddr, sizeof(servaddr));
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <iostream>
+
+
+// Release 构建定义了 NDEBUG，assert 不起作用，测试使用自己的检查宏。
+// 失败时打印位置并计数，不中止，main 返回 test_result() 作为 ctest 的结果
+inline int &test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline int test_result() {
+    if (test_failures() == 0) {
+        std::cout << "all checks passed" << std::endl;
+        return 0;
+    }
+    std::cerr << test_failures() << " check(s) failed" << std::endl;
+    return 1;
+}
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed"   \
+                      << std::endl;                                                   \
+            ++test_failures();                                                        \
+        }                                                                             \
+    } while (0)
+
+// a 和 b 需要能输出到 std::ostream
+#define CHECK_EQ(a, b)                                                                \
+    do {                                                                              \
+        auto &&check_a_ = (a);                                                        \
+        auto &&check_b_ = (b);                                                        \
+        if (!(check_a_ == check_b_)) {                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #a ", " #b ") " \
+                      << "failed: " << check_a_ << " != " << check_b_ << std::endl;   \
+            ++test_failures();                                                        \
+        }                                                                             \
+    } while (0)
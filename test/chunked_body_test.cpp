@@ -0,0 +1,253 @@
+#include <climits>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+#include "BodySpool.h"
+#include "ChunkedDecoder.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+
+struct DecodeResult {
+    string data;
+    bool done{false};
+    bool error{false};
+    size_t pieces{0};
+    size_t max_piece{0};
+    string rest;   // 解码结束后缓冲区中剩下的数据
+};
+
+
+// 模拟 HttpData::receive_body: 输入按 reads 分批到达，每次到达后尽量解码，已消耗的字节从缓冲区移除
+DecodeResult decode_in_reads(const vector<string> &reads, size_t max_data = SIZE_MAX) {
+    ChunkedDecoder decoder;
+    DecodeResult result;
+    string buffer;
+    for (const string &read: reads) {
+        buffer += read;
+        while (!decoder.done() && !decoder.error()) {
+            string_view data;
+            size_t consumed = decoder.decode(buffer, max_data, data);
+            if (!data.empty()) {
+                result.data.append(data);
+                ++result.pieces;
+                result.max_piece = max(result.max_piece, data.size());
+            }
+            buffer.erase(0, consumed);
+            if (consumed == 0 && data.empty()) {
+                break;
+            }
+        }
+    }
+    result.done = decoder.done();
+    result.error = decoder.error();
+    result.rest = buffer;
+    return result;
+}
+
+
+DecodeResult decode_all(const string &input, size_t max_data = SIZE_MAX) {
+    return decode_in_reads({input}, max_data);
+}
+
+
+// 每次只到达一个字节，每个 CRLF 都会被拆开
+DecodeResult decode_bytewise(const string &input) {
+    vector<string> reads;
+    for (char c: input) {
+        reads.emplace_back(1, c);
+    }
+    return decode_in_reads(reads);
+}
+
+
+void basic_test() {
+    cout << "----------chunked basic-----------" << endl;
+    DecodeResult r = decode_all("5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n");
+    CHECK(r.done);
+    CHECK(!r.error);
+    CHECK_EQ(r.data, string("hello world"));
+    CHECK(r.rest.empty());
+
+    // 大小写十六进制
+    r = decode_all("a\r\n0123456789\r\nB\r\nabcdefghijk\r\n0\r\n\r\n");
+    CHECK(r.done);
+    CHECK_EQ(r.data, string("0123456789abcdefghijk"));
+
+    // 只有结束块
+    r = decode_all("0\r\n\r\n");
+    CHECK(r.done);
+    CHECK(r.data.empty());
+
+    // 结束之后的数据属于下一个请求，不消耗
+    r = decode_all("3\r\nabc\r\n0\r\n\r\nGET / HTTP/1.1\r\n\r\n");
+    CHECK(r.done);
+    CHECK_EQ(r.data, string("abc"));
+    CHECK_EQ(r.rest, string("GET / HTTP/1.1\r\n\r\n"));
+}
+
+
+void extension_trailer_test() {
+    cout << "----------chunked extensions and trailers-----------" << endl;
+    const string input =
+        "5;name=value\r\nhello\r\n"
+        "6 ; a=b;c=\"d\"\r\n world\r\n"
+        "0;last\r\n"
+        "X-Checksum: 1234\r\n"
+        "X-Other: a, b\r\n"
+        "\r\n";
+    DecodeResult r = decode_all(input);
+    CHECK(r.done);
+    CHECK(!r.error);
+    CHECK_EQ(r.data, string("hello world"));
+    CHECK(r.rest.empty());
+
+    // 长度之后只能是空白和扩展
+    CHECK(decode_all("5x\r\nhello\r\n0\r\n\r\n").error);
+    CHECK(decode_all("5 6\r\nhello\r\n0\r\n\r\n").error);
+
+    // trailer 总长度有上限
+    string trailer = "0\r\n";
+    while (trailer.size() <= CHUNKED_MAX_TRAILER) {
+        trailer += "X-Padding: 0123456789012345678901234567890123456789\r\n";
+    }
+    trailer += "\r\n";
+    CHECK(decode_all(trailer).error);
+}
+
+
+void split_read_test() {
+    cout << "----------chunked split reads-----------" << endl;
+    const string input = "5;ext=1\r\nhello\r\n10\r\n0123456789abcdef\r\n0\r\nX-Trailer: 1\r\n\r\n";
+    const string expected = "hello0123456789abcdef";
+
+    DecodeResult r = decode_bytewise(input);
+    CHECK(r.done);
+    CHECK(!r.error);
+    CHECK_EQ(r.data, expected);
+
+    // 按每一个位置拆成两次到达
+    for (size_t split = 1; split < input.size(); ++split) {
+        r = decode_in_reads({input.substr(0, split), input.substr(split)});
+        if (!r.done || r.data != expected) {
+            cerr << "split at " << split << " failed" << endl;
+        }
+        CHECK(r.done);
+        CHECK_EQ(r.data, expected);
+    }
+
+    // CRLF 正好被拆开: 长度行、数据之后、trailer 结尾
+    r = decode_in_reads({"5\r", "\nhel", "lo\r", "\n0\r", "\n\r", "\n"});
+    CHECK(r.done);
+    CHECK_EQ(r.data, string("hello"));
+
+    // 拆开的 CRLF 中 '\n' 之前不是 '\r'
+    r = decode_in_reads({"3\r\nabc", "X\n0\r\n\r\n"});
+    CHECK(r.error);
+    r = decode_in_reads({"3\r\nabc\r", "X0\r\n\r\n"});
+    CHECK(r.error);
+
+    // 没有结束块时等待更多输入
+    r = decode_in_reads({"5\r\nhello\r\n", "0\r\n"});
+    CHECK(!r.done);
+    CHECK(!r.error);
+    CHECK_EQ(r.data, string("hello"));
+}
+
+
+void max_data_test() {
+    cout << "----------chunked max data-----------" << endl;
+    DecodeResult r = decode_all("a\r\n0123456789\r\n0\r\n\r\n", 4);
+    CHECK(r.done);
+    CHECK_EQ(r.data, string("0123456789"));
+    CHECK_EQ(r.pieces, 3u);
+    CHECK_EQ(r.max_piece, 4u);
+}
+
+
+void overflow_test() {
+    cout << "----------chunked size overflow-----------" << endl;
+    // 64 位 size_t 最多 16 个十六进制位
+    CHECK(decode_all("10000000000000000\r\n").error);
+    CHECK(decode_all("ffffffffffffffff0\r\n").error);
+    CHECK(decode_all("00000000000000000000000000000000000000000000000000000001\r\nx\r\n0\r\n\r\n").done);
+
+    // 不溢出的最大值可以解析，数据不完整时等待
+    DecodeResult r = decode_all("ffffffffffffffff\r\nabc");
+    CHECK(!r.error);
+    CHECK(!r.done);
+    CHECK_EQ(r.data, string("abc"));
+
+    // 长度行超长，即使没有换行也要出错，不能无限等待
+    CHECK(decode_all(string(CHUNKED_MAX_LINE + 1, '0')).error);
+    CHECK(decode_all("1;" + string(CHUNKED_MAX_LINE, 'e') + "\r\nx\r\n0\r\n\r\n").error);
+}
+
+
+void malformed_test() {
+    cout << "----------chunked malformed-----------" << endl;
+    CHECK(decode_all("zz\r\nhello\r\n").error);           // 不是十六进制
+    CHECK(decode_all("\r\nhello\r\n").error);             // 没有长度
+    CHECK(decode_all(";ext\r\nhello\r\n").error);         // 只有扩展
+    CHECK(decode_all("-5\r\nhello\r\n").error);           // 负数
+    CHECK(decode_all("5\nhello\r\n0\r\n\r\n").error);     // 长度行只有 LF
+    CHECK(decode_all("3\r\nabcX\r\n0\r\n\r\n").error);    // 数据比长度长
+    CHECK(decode_all("3\r\nab\r\n0\r\n\r\n").error);      // 数据比长度短
+}
+
+
+void spool_test() {
+    cout << "----------body spool threshold-----------" << endl;
+    BodySpool spool(16, "/tmp");
+    CHECK(spool.append("0123456789"));
+    CHECK(!spool.spooled());
+    CHECK_EQ(spool.size(), 10u);
+    CHECK(spool.append("abcdef"));
+    // 正好等于阈值时仍然在内存中
+    CHECK(!spool.spooled());
+    CHECK_EQ(spool.memory(), string("0123456789abcdef"));
+
+    CHECK(spool.append("X"));
+    CHECK(spool.spooled());
+    CHECK(spool.fd() >= 0);
+    CHECK(spool.memory().empty());
+    CHECK(spool.append("yz"));
+    CHECK_EQ(spool.size(), 19u);
+
+    // 内存中的数据和之后的数据按顺序写入临时文件
+    string content(spool.size(), '\0');
+    CHECK_EQ(pread(spool.fd(), content.data(), content.size(), 0), static_cast<ssize_t>(content.size()));
+    CHECK_EQ(content, string("0123456789abcdefXyz"));
+
+    // 一次追加就越过阈值
+    BodySpool large(4, "/tmp");
+    CHECK(large.append("ab"));
+    CHECK(large.append(string(100, 'c')));
+    CHECK(large.spooled());
+    CHECK_EQ(large.size(), 102u);
+    content.assign(large.size(), '\0');
+    CHECK_EQ(pread(large.fd(), content.data(), content.size(), 0), static_cast<ssize_t>(content.size()));
+    CHECK_EQ(content, "ab" + string(100, 'c'));
+
+    // 临时文件无法创建时追加失败
+    BodySpool missing(4, "/nonexistent-spool-dir");
+    CHECK(missing.append("ab"));
+    CHECK(!missing.append("cdefg"));
+    CHECK(!missing.spooled());
+}
+
+
+int main() {
+    basic_test();
+    extension_trailer_test();
+    split_read_test();
+    max_data_test();
+    overflow_test();
+    malformed_test();
+    spool_test();
+    return test_result();
+}
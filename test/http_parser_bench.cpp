@@ -0,0 +1,102 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "HttpParser.h"
+#include "HttpScan.h"
+
+using namespace std;
+
+// 典型的浏览器请求头
+const string request =
+    "GET /static/js/app.min.js?v=20231018 HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", \"Not=A?Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/118.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Accept: */*\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: script\r\n"
+    "Referer: https://www.example.com/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: session=0123456789abcdef; theme=dark; _ga=GA1.2.1234567890.1697600000\r\n"
+    "If-None-Match: \"5f3a-18b3c0e2d40\"\r\n"
+    "\r\n";
+
+// 原来 HttpData 中基于 substr 和 std::map 的解析方式，作为对比
+size_t legacy_parse(string content) {
+    size_t pos = content.find('\r');
+    string request_line = content.substr(0, pos);
+    content = content.substr(pos + 1);
+
+    size_t get_pos = request_line.find("GET");
+    size_t post_pos = request_line.find("POST");
+    size_t head_pos = request_line.find("HEAD");
+    pos = get_pos != string::npos ? get_pos : (post_pos != string::npos ? post_pos : head_pos);
+
+    pos = request_line.find('/', pos);
+    size_t file_name_end = request_line.find(' ', pos);
+    string filename = request_line.substr(pos + 1, file_name_end - pos - 1);
+    size_t qmark_pos = filename.find('?');
+    if (qmark_pos != string::npos) {
+        filename = filename.substr(0, qmark_pos);
+    }
+    string ver_str = request_line.substr(request_line.find('/', file_name_end) + 1, 3);
+
+    map<string, string> headers;
+    size_t line_start = content.find_first_not_of("\r\n");
+    while (line_start < content.size()) {
+        size_t line_end = content.find('\r', line_start);
+        if (line_end == line_start || line_end == string::npos) {
+            break;
+        }
+        size_t colon = content.find(':', line_start);
+        string key(content.begin() + line_start, content.begin() + colon);
+        string value(content.begin() + colon + 2, content.begin() + line_end);
+        headers[key] = value;
+        line_start = line_end + 2;
+    }
+    content = content.substr(line_start);
+
+    return headers.size() + filename.size() + ver_str.size();
+}
+
+size_t parse(HttpRequestParser &parser) {
+    parser.reset();
+    if (parser.parse_request_line(request) != URIState::PARSE_URI_SUCCESS
+        || parser.parse_headers(request) != HeaderState::PARSE_HEADER_SUCCESS) {
+        return 0;
+    }
+    return parser.headers(request).size() + parser.path(request).size()
+        + parser.headers(request).get("connection").size();
+}
+
+template <typename Func>
+void bench(const char *name, int rounds, Func func) {
+    size_t sink = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        sink += func();
+    }
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    cout << name << ": " << static_cast<double>(elapsed) / rounds << " ns/request"
+         << " (checksum " << sink << ")" << endl;
+}
+
+int main() {
+    const int rounds = 1'000'000;
+    HttpRequestParser parser;
+
+    cout << "----------parse " << request.size() << " bytes request, scan backend " << scan_backend_name()
+         << "-----------" << endl;
+    bench("legacy substr/std::map", rounds, []() { return legacy_parse(request); });
+    bench("HttpRequestParser", rounds, [&parser]() { return parse(parser); });
+
+    return 0;
+}
@@ -0,0 +1,372 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "HttpParser.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+
+enum class ParseResult { AGAIN, ERROR, OK };
+
+const char *result_name(ParseResult result) {
+    switch (result) {
+        case ParseResult::AGAIN: return "AGAIN";
+        case ParseResult::ERROR: return "ERROR";
+        case ParseResult::OK: return "OK";
+    }
+    return "?";
+}
+
+
+// 和 HttpData 一样先解析请求行，成功之后解析请求头。buf 是从请求起始位置开始的缓冲区，
+// 数据不完整时缓冲区追加数据后用同一个 parser 继续
+struct RequestParse {
+    HttpRequestParser parser;
+    bool line_done{false};
+
+    ParseResult feed(string_view buf) {
+        if (!line_done) {
+            URIState state = parser.parse_request_line(buf);
+            if (state == URIState::PARSE_URI_AGAIN) {
+                return ParseResult::AGAIN;
+            }
+            if (state == URIState::PARSE_URI_ERROR) {
+                return ParseResult::ERROR;
+            }
+            line_done = true;
+        }
+        HeaderState state = parser.parse_headers(buf);
+        if (state == HeaderState::PARSE_HEADER_AGAIN) {
+            return ParseResult::AGAIN;
+        }
+        return state == HeaderState::PARSE_HEADER_SUCCESS ? ParseResult::OK : ParseResult::ERROR;
+    }
+};
+
+
+struct ParserCase {
+    string input;
+    ParseResult result;
+    HttpMethod method;
+    HttpVersion version;
+    string path;
+    vector<pair<string, string>> headers;   // OK 时按顺序的全部请求头
+};
+
+
+string describe(const string &input) {
+    string out;
+    for (char c: input.substr(0, 60)) {
+        if (c == '\r') {
+            out += "\\r";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += "\\x" + to_string(static_cast<unsigned char>(c));
+        } else {
+            out += c;
+        }
+    }
+    return input.size() > 60 ? out + "... (" + to_string(input.size()) + " bytes)" : out;
+}
+
+
+void check_success(const ParserCase &c, RequestParse &p, string_view buf) {
+    CHECK(p.parser.method() == c.method);
+    CHECK(p.parser.version() == c.version);
+    CHECK_EQ(p.parser.path(buf), c.path);
+    CHECK_EQ(p.parser.header_length(), c.input.size());
+    const HttpHeaders &headers = p.parser.headers(buf);
+    CHECK_EQ(headers.size(), c.headers.size());
+    for (size_t i = 0; i < headers.size() && i < c.headers.size(); ++i) {
+        CHECK_EQ(headers.key(i), c.headers[i].first);
+        CHECK_EQ(headers.value(i), c.headers[i].second);
+    }
+}
+
+
+// 一次到达、逐字节到达、在每个位置拆成两次到达，结果都相同
+void run_cases(const vector<ParserCase> &cases) {
+    for (const ParserCase &c: cases) {
+        RequestParse whole;
+        ParseResult result = whole.feed(c.input);
+        if (result != c.result) {
+            cerr << "\"" << describe(c.input) << "\": got " << result_name(result) << ", expected "
+                 << result_name(c.result) << endl;
+        }
+        CHECK(result == c.result);
+        if (result == ParseResult::OK && c.result == ParseResult::OK) {
+            check_success(c, whole, c.input);
+        }
+
+        RequestParse bytewise;
+        result = ParseResult::AGAIN;
+        size_t n = 0;
+        while (result == ParseResult::AGAIN && n < c.input.size()) {
+            result = bytewise.feed(string_view(c.input).substr(0, ++n));
+        }
+        if (result != c.result) {
+            cerr << "\"" << describe(c.input) << "\" byte by byte: got " << result_name(result) << " at " << n
+                 << ", expected " << result_name(c.result) << endl;
+        }
+        CHECK(result == c.result);
+        if (result == ParseResult::OK && c.result == ParseResult::OK) {
+            // 最后一个字节到达时才完整
+            CHECK_EQ(n, c.input.size());
+            check_success(c, bytewise, c.input);
+        }
+
+        for (size_t split = 1; split < c.input.size(); ++split) {
+            RequestParse two_reads;
+            result = two_reads.feed(string_view(c.input).substr(0, split));
+            if (result == ParseResult::AGAIN) {
+                result = two_reads.feed(c.input);
+            }
+            if (result != c.result) {
+                cerr << "\"" << describe(c.input) << "\" split at " << split << ": got " << result_name(result)
+                     << ", expected " << result_name(c.result) << endl;
+                CHECK(result == c.result);
+                break;
+            }
+        }
+    }
+}
+
+
+const HttpMethod GET = HttpMethod::METHOD_GET;
+const HttpMethod POST = HttpMethod::METHOD_POST;
+const HttpMethod HEAD = HttpMethod::METHOD_HEAD;
+const HttpVersion V10 = HttpVersion::HTTP_10;
+const HttpVersion V11 = HttpVersion::HTTP_11;
+const ParseResult OK = ParseResult::OK;
+const ParseResult ERROR = ParseResult::ERROR;
+
+
+void valid_test() {
+    cout << "----------parser valid requests-----------" << endl;
+    run_cases({
+        {"GET / HTTP/1.1\r\n\r\n", OK, GET, V11, "", {}},
+        {"GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n", OK, GET, V11,
+         "index.html", {{"Host", "localhost"}, {"Connection", "keep-alive"}}},
+        {"HEAD /a/b.css?v=1&x=2 HTTP/1.0\r\n\r\n", OK, HEAD, V10, "a/b.css", {}},
+        {"POST /upload HTTP/1.1\r\nContent-Length: 5\r\n\r\n", OK, POST, V11, "upload", {{"Content-Length", "5"}}},
+        // 只有 LF 的行尾，以及混用
+        {"GET /lf HTTP/1.1\nHost: a\n\n", OK, GET, V11, "lf", {{"Host", "a"}}},
+        {"GET /mixed HTTP/1.1\r\nHost: a\nAccept: */*\r\n\n", OK, GET, V11, "mixed", {{"Host", "a"}, {"Accept", "*/*"}}},
+        // 请求行之前的空行忽略
+        {"\r\n\r\nGET /after-empty HTTP/1.1\r\n\r\n", OK, GET, V11, "after-empty", {}},
+        // value 两端的空白去掉，中间的保留；空 value；制表符
+        {"GET / HTTP/1.1\r\nA:   x  y \t\r\nB:\r\nC:\tz\r\n\r\n", OK, GET, V11, "",
+         {{"A", "x  y"}, {"B", ""}, {"C", "z"}}},
+        // value 中可以有 ':' 和高位字节
+        {"GET / HTTP/1.1\r\nReferer: http://h:80/p\r\nX-Utf8: \xe4\xbd\xa0\xe5\xa5\xbd\r\n\r\n", OK, GET, V11, "",
+         {{"Referer", "http://h:80/p"}, {"X-Utf8", "\xe4\xbd\xa0\xe5\xa5\xbd"}}},
+        // 查询参数中的空白之外的字符不影响路径
+        {"GET /?a=/b?c HTTP/1.1\r\n\r\n", OK, GET, V11, "", {}},
+    });
+}
+
+
+void malformed_test() {
+    cout << "----------parser malformed requests-----------" << endl;
+    const HttpMethod M = GET;
+    run_cases({
+        // 方法
+        {"PUT / HTTP/1.1\r\n\r\n", ERROR, M, V11, "", {}},
+        {"get / HTTP/1.1\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GETX / HTTP/1.1\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET\r\n\r\n", ERROR, M, V11, "", {}},
+        {" GET / HTTP/1.1\r\n\r\n", ERROR, M, V11, "", {}},
+        // URI
+        {"GET  / HTTP/1.1\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET index.html HTTP/1.1\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET /\r\n\r\n", ERROR, M, V11, "", {}},
+        // 版本
+        {"GET / HTTP/1.2\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/2.0\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / http/1.1\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1 \r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / \r\n\r\n", ERROR, M, V11, "", {}},
+        // 行内的控制字符和单独的 CR
+        {"GET /a\x01 HTTP/1.1\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1\rX\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1\r\nHost: a\x7f\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1\r\nHost: a\rb\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1\r\nHost: a\r\n\r\r\n", ERROR, M, V11, "", {}},
+        // 请求头
+        {"GET / HTTP/1.1\r\nNoColon\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1\r\n: empty-key\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1\r\nHost : a\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1\r\nHo st: a\r\n\r\n", ERROR, M, V11, "", {}},
+        {"GET / HTTP/1.1\r\n\tFolded: a\r\n\r\n", ERROR, M, V11, "", {}},
+    });
+}
+
+
+string request_with_headers(size_t count) {
+    string request = "GET /many HTTP/1.1\r\n";
+    for (size_t i = 0; i < count; ++i) {
+        request += "X-H" + to_string(i) + ": " + to_string(i) + "\r\n";
+    }
+    return request + "\r\n";
+}
+
+
+void header_count_test() {
+    cout << "----------parser header count limit-----------" << endl;
+    vector<pair<string, string>> expected;
+    for (size_t i = 0; i < HttpHeaders::MAX_FIELDS; ++i) {
+        expected.emplace_back("X-H" + to_string(i), to_string(i));
+    }
+    run_cases({
+        {request_with_headers(HttpHeaders::MAX_FIELDS), OK, GET, V11, "many", expected},
+        {request_with_headers(HttpHeaders::MAX_FIELDS + 1), ERROR, GET, V11, "", {}},
+    });
+}
+
+
+// 请求行 + 请求头 (含空行) 正好 total 字节
+string request_line_of_size(size_t total) {
+    string head = "GET /";
+    string tail = " HTTP/1.1\r\n\r\n";
+    return head + string(total - head.size() - tail.size(), 'a') + tail;
+}
+
+string header_block_of_size(size_t total) {
+    string head = "GET / HTTP/1.1\r\nX-Pad: ";
+    string tail = "\r\n\r\n";
+    return head + string(total - head.size() - tail.size(), 'b') + tail;
+}
+
+
+void header_size_test() {
+    cout << "----------parser header size limit-----------" << endl;
+    const size_t MAX = MAX_REQUEST_HEADER_SIZE;
+    string long_path(MAX - string("GET / HTTP/1.1\r\n\r\n").size(), 'a');
+    string long_value(MAX - string("GET / HTTP/1.1\r\nX-Pad: \r\n\r\n").size(), 'b');
+    run_cases({
+        // 正好等于上限
+        {request_line_of_size(MAX), OK, GET, V11, long_path, {}},
+        {header_block_of_size(MAX), OK, GET, V11, "", {{"X-Pad", long_value}}},
+        // 超过上限一个字节: 请求行本身，以及请求行加请求头
+        {request_line_of_size(MAX + 1), ERROR, GET, V11, "", {}},
+        {header_block_of_size(MAX + 1), ERROR, GET, V11, "", {}},
+        {request_line_of_size(2 * MAX), ERROR, GET, V11, "", {}},
+    });
+
+    // 没有行尾时，超过上限就出错，不再等待更多数据
+    RequestParse line;
+    CHECK(line.feed("GET /" + string(MAX - 5, 'a')) == ParseResult::AGAIN);
+    CHECK(line.feed("GET /" + string(MAX - 4, 'a')) == ParseResult::ERROR);
+    RequestParse header;
+    string prefix = "GET / HTTP/1.1\r\nX-Pad: ";
+    CHECK(header.feed(prefix + string(MAX - prefix.size(), 'b')) == ParseResult::AGAIN);
+    CHECK(header.feed(prefix + string(MAX - prefix.size() + 1, 'b')) == ParseResult::ERROR);
+
+    // 一次到达的超长请求行在请求行阶段就出错，不等到解析请求头
+    HttpRequestParser parser;
+    string long_line = "GET /" + string(MAX, 'a') + " HTTP/1.1\r\n";
+    CHECK(parser.parse_request_line(long_line) == URIState::PARSE_URI_ERROR);
+    parser.reset();
+    CHECK(parser.parse_request_line(request_line_of_size(MAX)) == URIState::PARSE_URI_SUCCESS);
+}
+
+
+void headers_lookup_test() {
+    cout << "----------HttpHeaders lookup-----------" << endl;
+    string buf = "GET / HTTP/1.1\r\n"
+                 "Host: example.com\r\n"
+                 "Accept-Encoding: gzip, br\r\n"
+                 "X-Dup: first\r\n"
+                 "x-dup: second\r\n"
+                 "Empty:\r\n"
+                 "\r\n"
+                 "body";
+    RequestParse p;
+    CHECK(p.feed(buf) == ParseResult::OK);
+    CHECK_EQ(p.parser.header_length(), buf.size() - 4);
+
+    const HttpHeaders &headers = p.parser.headers(buf);
+    CHECK_EQ(headers.size(), 5u);
+    // key 不区分大小写
+    CHECK_EQ(headers.get("Host"), string_view("example.com"));
+    CHECK_EQ(headers.get("HOST"), string_view("example.com"));
+    CHECK_EQ(headers.get("accept-encoding"), string_view("gzip, br"));
+    // 重复的 key 返回第一个
+    CHECK_EQ(headers.get("X-DUP"), string_view("first"));
+    // 空 value 存在，但值为空；不存在的 key 返回空
+    CHECK(headers.contains("Empty"));
+    CHECK(headers.get("Empty").empty());
+    CHECK(!headers.contains("Missing"));
+    CHECK(headers.get("Missing").empty());
+    // 前缀不算匹配
+    CHECK(!headers.contains("Hos"));
+    CHECK(!headers.contains("Host2"));
+
+    CHECK(HttpHeaders::equals_ignore_case("Content-Length", "content-LENGTH"));
+    CHECK(!HttpHeaders::equals_ignore_case("Content-Length", "Content-Lengt"));
+    CHECK(!HttpHeaders::equals_ignore_case("a-b", "a_b"));
+
+    // 只记录偏移，缓冲区移动之后 rebase 到新的地址仍然有效
+    string moved = buf;
+    const HttpHeaders &rebased = p.parser.headers(moved);
+    CHECK_EQ(rebased.get("host"), string_view("example.com"));
+    CHECK(rebased.get("host").data() >= moved.data() && rebased.get("host").data() < moved.data() + moved.size());
+    CHECK_EQ(p.parser.path(moved), string_view(""));
+
+    // reset 之后清空
+    p.parser.reset();
+    CHECK_EQ(p.parser.headers(buf).size(), 0u);
+    CHECK_EQ(p.parser.header_length(), 0u);
+}
+
+
+// 一个缓冲区中有多个请求: 解析完一个之后移除 header_length 字节，reset 后解析下一个
+void pipeline_test() {
+    cout << "----------parser pipelined requests-----------" << endl;
+    string buf = "GET /one HTTP/1.1\r\nHost: a\r\n\r\n"
+                 "HEAD /two HTTP/1.0\r\n\r\n"
+                 "POST /three HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+                 "GET /four HTTP/1.1\nX: y\n\n"
+                 "GET /fi";
+
+    struct Expected {
+        HttpMethod method;
+        string path;
+        size_t body;   // 请求头之后属于这个请求的请求体字节数
+    };
+    const vector<Expected> expected = {{GET, "one", 0}, {HEAD, "two", 0}, {POST, "three", 3}, {GET, "four", 0}};
+
+    string_view rest = buf;
+    RequestParse p;
+    for (const Expected &e: expected) {
+        CHECK(p.feed(rest) == ParseResult::OK);
+        CHECK(p.parser.method() == e.method);
+        CHECK_EQ(p.parser.path(rest), e.path);
+        rest.remove_prefix(p.parser.header_length() + e.body);
+        p.parser.reset();
+        p.line_done = false;
+    }
+    CHECK_EQ(p.parser.headers(rest).size(), 0u);
+    // 最后一个请求不完整
+    CHECK(p.feed(rest) == ParseResult::AGAIN);
+    string completed = string(rest) + "ve HTTP/1.1\r\n\r\n";
+    CHECK(p.feed(completed) == ParseResult::OK);
+    CHECK_EQ(p.parser.path(completed), string_view("five"));
+}
+
+
+int main() {
+    valid_test();
+    malformed_test();
+    header_count_test();
+    header_size_test();
+    headers_lookup_test();
+    pipeline_test();
+    return test_result();
+}
@@ -0,0 +1,214 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "HttpData.h"
+#include "Logger.h"
+#include "Server.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+
+constexpr size_t BIG_CHUNK = 16 * 1024;
+constexpr size_t BIG_CHUNKS = 256;                      // 流式响应共 4 MB
+constexpr size_t PIPELINE_CAP = 64 * 1024 * 1024;       // 流式响应期间最多尝试发送的字节数
+// 流式响应期间服务端不再读取，对方能写入的只有两端的 socket 缓冲区和之前读到的一轮
+constexpr size_t PIPELINE_LIMIT = 16 * 1024 * 1024;
+
+const string SMALL_REQUEST = "GET /small HTTP/1.1\r\nHost: t\r\nConnection: keep-alive\r\n\r\n";
+
+
+void register_routes() {
+    // 慢速的大响应: 客户端不读取时停在发送缓冲区满的状态
+    HttpData::register_stream_handler("big", "text/plain", []() -> HttpData::StreamProducer {
+        return [index = size_t{0}](string &chunk) mutable -> bool {
+            chunk.assign(BIG_CHUNK, static_cast<char>('a' + index % 26));
+            return ++index < BIG_CHUNKS;
+        };
+    });
+    HttpData::register_stream_handler("small", "text/plain", []() -> HttpData::StreamProducer {
+        return [](string &chunk) -> bool {
+            chunk = "ok\n";
+            return false;
+        };
+    });
+}
+
+
+int connect_to(int port) {
+    for (int retry = 0; retry < 100; ++retry) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+    return -1;
+}
+
+
+bool send_all(int fd, string_view data) {
+    while (!data.empty()) {
+        ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+}
+
+
+// 解析 pos 处的一个 chunked 响应，返回响应体，格式错误时返回 false
+bool parse_chunked_response(const string &data, size_t &pos, string &body) {
+    size_t header_end = data.find("\r\n\r\n", pos);
+    if (data.compare(pos, 15, "HTTP/1.1 200 OK") != 0 || header_end == string::npos) {
+        return false;
+    }
+    pos = header_end + 4;
+    body.clear();
+    while (true) {
+        size_t line_end = data.find("\r\n", pos);
+        if (line_end == string::npos) {
+            return false;
+        }
+        size_t size = strtoul(data.c_str() + pos, nullptr, 16);
+        pos = line_end + 2;
+        if (size == 0) {
+            if (data.compare(pos, 2, "\r\n") != 0) {
+                return false;
+            }
+            pos += 2;
+            return true;
+        }
+        if (pos + size + 2 > data.size()) {
+            return false;
+        }
+        body.append(data, pos, size);
+        pos += size + 2;
+    }
+}
+
+
+// 请求 /big 之后不读取响应，持续发送流水线请求直到发不出去，然后读取全部响应
+void pipeline_behind_stream_test(int port) {
+    int fd = connect_to(port);
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+
+    // 流式请求和后面的请求一起到达，服务端在同一次 handle_read 中开始流式响应
+    CHECK(send_all(fd, "GET /big HTTP/1.1\r\nHost: t\r\nConnection: keep-alive\r\n\r\n"));
+
+    // 非阻塞发送，连续 300ms 发不出去时停止
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    string pipeline;
+    while (pipeline.size() < 64 * 1024) {
+        pipeline += SMALL_REQUEST;
+    }
+    size_t sent = 0;
+    auto last_progress = chrono::steady_clock::now();
+    while (sent < PIPELINE_CAP && chrono::steady_clock::now() - last_progress < chrono::milliseconds(300)) {
+        size_t offset = sent % SMALL_REQUEST.size();
+        ssize_t n = send(fd, pipeline.data() + offset, pipeline.size() - offset, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += static_cast<size_t>(n);
+            last_progress = chrono::steady_clock::now();
+        } else {
+            CHECK(n < 0 && errno == EAGAIN);
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+    }
+    cout << "sent " << sent << " bytes of pipelined requests behind the stream" << endl;
+    CHECK(sent < PIPELINE_LIMIT);
+
+    // 补全最后一个请求之后关闭写端，服务端应答完全部请求后关闭连接。同时读取全部响应
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    string response;
+    thread reader([fd, &response]() {
+        char buf[64 * 1024];
+        ssize_t n;
+        while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+            response.append(buf, static_cast<size_t>(n));
+        }
+    });
+    size_t offset = sent % SMALL_REQUEST.size();
+    size_t small_requests = sent / SMALL_REQUEST.size();
+    if (offset != 0) {
+        CHECK(send_all(fd, string_view(SMALL_REQUEST).substr(offset)));
+        ++small_requests;
+    }
+    shutdown(fd, SHUT_WR);
+    reader.join();
+    close(fd);
+
+    // 流式响应完整，之后的请求按顺序应答
+    size_t pos = 0;
+    string body;
+    CHECK(parse_chunked_response(response, pos, body));
+    CHECK_EQ(body.size(), BIG_CHUNK * BIG_CHUNKS);
+    bool pattern_ok = body.size() == BIG_CHUNK * BIG_CHUNKS;
+    for (size_t i = 0; pattern_ok && i < BIG_CHUNKS; ++i) {
+        pattern_ok = body[i * BIG_CHUNK] == static_cast<char>('a' + i % 26)
+                     && body[(i + 1) * BIG_CHUNK - 1] == static_cast<char>('a' + i % 26);
+    }
+    CHECK(pattern_ok);
+
+    size_t small_responses = 0;
+    while (pos < response.size() && parse_chunked_response(response, pos, body) && body == "ok\n") {
+        ++small_responses;
+    }
+    CHECK_EQ(small_responses, small_requests);
+    CHECK_EQ(pos, response.size());
+}
+
+
+// 每种注册方式启动一个 Server，连接创建之前设置
+void run_with_server(int port, bool oneshot) {
+    cout << "----------pipeline behind stream (oneshot " << oneshot << ")-----------" << endl;
+    HttpData::set_oneshot(oneshot);
+    atomic<EventLoop *> main_loop{nullptr};
+    thread server_thread([&]() {
+        EventLoop loop;
+        Server server(&loop, 1, port);
+        server.start();
+        main_loop = &loop;
+        loop.loop();
+    });
+
+    pipeline_behind_stream_test(port);
+
+    while (main_loop.load() == nullptr) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    main_loop.load()->quit();
+    server_thread.join();
+}
+
+
+int main() {
+    Logger::set_log_file_name("/dev/null");
+    register_routes();
+
+    int port = 20000 + getpid() % 20000;
+    run_with_server(port, true);
+    run_with_server(port + 1, false);
+    return test_result();
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "HttpRange.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+
+struct RangeCase {
+    const char *header;
+    size_t file_size;
+    RangeState state;
+    vector<ByteRange> ranges;   // RANGE_SATISFIABLE 时按请求顺序的区间
+};
+
+
+const char *state_name(RangeState state) {
+    switch (state) {
+        case RangeState::RANGE_NONE: return "RANGE_NONE";
+        case RangeState::RANGE_SATISFIABLE: return "RANGE_SATISFIABLE";
+        case RangeState::RANGE_NOT_SATISFIABLE: return "RANGE_NOT_SATISFIABLE";
+    }
+    return "?";
+}
+
+
+// "0-0,2-2,..." 共 count 个不重叠的单字节区间
+string single_byte_ranges(size_t count) {
+    string header = "bytes=";
+    for (size_t i = 0; i < count; ++i) {
+        header += (i > 0 ? "," : "") + to_string(i * 2) + "-" + to_string(i * 2);
+    }
+    return header;
+}
+
+
+void run_cases(const vector<RangeCase> &cases) {
+    for (const RangeCase &c: cases) {
+        ByteRanges ranges;
+        RangeState state = ranges.parse(c.header, c.file_size);
+        if (state != c.state) {
+            cerr << "\"" << c.header << "\" size " << c.file_size << ": got " << state_name(state)
+                 << ", expected " << state_name(c.state) << endl;
+        }
+        CHECK(state == c.state);
+        if (state != RangeState::RANGE_SATISFIABLE || c.state != RangeState::RANGE_SATISFIABLE) {
+            continue;
+        }
+        CHECK_EQ(ranges.size(), c.ranges.size());
+        for (size_t i = 0; i < ranges.size() && i < c.ranges.size(); ++i) {
+            CHECK_EQ(ranges[i].offset, c.ranges[i].offset);
+            CHECK_EQ(ranges[i].length, c.ranges[i].length);
+        }
+    }
+}
+
+
+void satisfiable_test() {
+    cout << "----------range satisfiable-----------" << endl;
+    const RangeState SAT = RangeState::RANGE_SATISFIABLE;
+    run_cases({
+        {"bytes=0-99", 1000, SAT, {{0, 100}}},
+        {"bytes=0-0", 1000, SAT, {{0, 1}}},
+        {"bytes=999-999", 1000, SAT, {{999, 1}}},
+        // 超出文件的末尾截断
+        {"bytes=990-2000", 1000, SAT, {{990, 10}}},
+        // 开放区间
+        {"bytes=900-", 1000, SAT, {{900, 100}}},
+        {"bytes=0-", 1000, SAT, {{0, 1000}}},
+        {"bytes=999-", 1000, SAT, {{999, 1}}},
+        // 后缀区间
+        {"bytes=-500", 1000, SAT, {{500, 500}}},
+        {"bytes=-1", 1000, SAT, {{999, 1}}},
+        {"bytes=-1000", 1000, SAT, {{0, 1000}}},
+        {"bytes=-1500", 1000, SAT, {{0, 1000}}},
+        // 多个区间保持请求中的顺序
+        {"bytes=0-0,-1", 1000, SAT, {{0, 1}, {999, 1}}},
+        {"bytes=500-599,0-99", 1000, SAT, {{500, 100}, {0, 100}}},
+        // 空白、大小写和空元素
+        {" bytes = 0-1 , 5-6 ", 1000, SAT, {{0, 2}, {5, 2}}},
+        {"BYTES=0-1", 1000, SAT, {{0, 2}}},
+        {"bytes=0-1,,2-3,", 1000, SAT, {{0, 2}, {2, 2}}},
+        // 不可满足的区间被跳过，其余的照常响应
+        {"bytes=5000-,0-0", 1000, SAT, {{0, 1}}},
+        {"bytes=-0,10-19", 1000, SAT, {{10, 10}}},
+        // 重叠但总长度不超过文件大小
+        {"bytes=0-10,5-15", 1000, SAT, {{0, 11}, {5, 11}}},
+    });
+}
+
+
+void not_satisfiable_test() {
+    cout << "----------range not satisfiable (416)-----------" << endl;
+    const RangeState UNSAT = RangeState::RANGE_NOT_SATISFIABLE;
+    run_cases({
+        {"bytes=1000-", 1000, UNSAT, {}},
+        {"bytes=1000-1999", 1000, UNSAT, {}},
+        {"bytes=2000-3000", 1000, UNSAT, {}},
+        {"bytes=-0", 1000, UNSAT, {}},
+        {"bytes=1000-1001,2000-", 1000, UNSAT, {}},
+        // 空文件没有可满足的区间
+        {"bytes=0-", 0, UNSAT, {}},
+        {"bytes=0-0", 0, UNSAT, {}},
+        {"bytes=-5", 0, UNSAT, {}},
+    });
+}
+
+
+void ignored_test() {
+    cout << "----------range ignored (200)-----------" << endl;
+    const RangeState NONE = RangeState::RANGE_NONE;
+    run_cases({
+        // 语法错误
+        {"", 1000, NONE, {}},
+        {"bytes=", 1000, NONE, {}},
+        {"bytes=,", 1000, NONE, {}},
+        {"0-1", 1000, NONE, {}},
+        {"items=0-1", 1000, NONE, {}},
+        {"bytes=abc", 1000, NONE, {}},
+        {"bytes=1", 1000, NONE, {}},
+        {"bytes=5-2", 1000, NONE, {}},
+        {"bytes=--1", 1000, NONE, {}},
+        {"bytes=+1-2", 1000, NONE, {}},
+        {"bytes=0-1x", 1000, NONE, {}},
+        {"bytes=0-1,abc", 1000, NONE, {}},
+        {"bytes=-", 1000, NONE, {}},
+        {"bytes=99999999999999999999-", 1000, NONE, {}},
+        {"bytes=0-99999999999999999999", 1000, NONE, {}},
+        // 重叠区间放大响应
+        {"bytes=0-599,400-999", 1000, NONE, {}},
+        {"bytes=0-,0-", 1000, NONE, {}},
+        {"bytes=-600,-600", 1000, NONE, {}},
+    });
+}
+
+
+void range_cap_test() {
+    cout << "----------range count cap-----------" << endl;
+    vector<ByteRange> expected;
+    for (size_t i = 0; i < ByteRanges::MAX_RANGES; ++i) {
+        expected.push_back({i * 2, 1});
+    }
+    string at_cap = single_byte_ranges(ByteRanges::MAX_RANGES);
+    string over_cap = single_byte_ranges(ByteRanges::MAX_RANGES + 1);
+    run_cases({
+        {at_cap.c_str(), 1000, RangeState::RANGE_SATISFIABLE, expected},
+        {over_cap.c_str(), 1000, RangeState::RANGE_NONE, {}},
+    });
+
+    // 不可满足的区间不占用名额
+    string with_unsatisfiable = at_cap + ",5000-,6000-";
+    run_cases({
+        {with_unsatisfiable.c_str(), 1000, RangeState::RANGE_SATISFIABLE, expected},
+    });
+
+    // 超过上限之后解析对象可以复用，状态被重置
+    ByteRanges ranges;
+    CHECK(ranges.parse(over_cap, 1000) == RangeState::RANGE_NONE);
+    CHECK_EQ(ranges.size(), 0u);
+    CHECK(ranges.parse("bytes=1-2", 1000) == RangeState::RANGE_SATISFIABLE);
+    CHECK_EQ(ranges.size(), 1u);
+}
+
+
+int main() {
+    satisfiable_test();
+    not_satisfiable_test();
+    ignored_test();
+    range_cap_test();
+    return test_result();
+}
@@ -0,0 +1,146 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "HttpScan.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+
+constexpr size_t MAX_LEN = 70;   // 覆盖 16 和 32 字节的整块以及之后的尾部
+constexpr size_t MAX_OFFSET = 32;  // 输入起始地址相对 32 字节对齐的偏移
+
+const vector<ScanBackend> backends = scan_backends();
+
+
+// 参考结果: 逐字节查表
+size_t reference_find(const string &input, const ScanRanges &ranges) {
+    for (size_t i = 0; i < input.size(); ++i) {
+        if (ranges.table[static_cast<unsigned char>(input[i])]) {
+            return i;
+        }
+    }
+    return input.size();
+}
+
+
+// 每个实现在不同对齐位置上的结果都和参考结果相同，公共入口 find_char_in_ranges 也一样
+void check_all(const string &input, const ScanRanges &ranges, const string &label) {
+    size_t expected = reference_find(input, ranges);
+    alignas(32) char storage[MAX_OFFSET + 128];
+    for (size_t offset = 0; offset < MAX_OFFSET; offset += 7) {
+        char *p = storage + offset;
+        input.copy(p, input.size());
+        const char *end = p + input.size();
+        for (const ScanBackend &backend: backends) {
+            auto got = static_cast<size_t>(backend.find(p, end, ranges) - p);
+            if (got != expected) {
+                cerr << backend.name << " " << label << " len " << input.size() << " offset " << offset
+                     << ": got " << got << ", expected " << expected << endl;
+                CHECK_EQ(got, expected);
+            }
+        }
+        CHECK_EQ(static_cast<size_t>(find_char_in_ranges(p, end, ranges) - p), expected);
+    }
+}
+
+
+const ScanRanges LINE_END{"\000\010\012\037\177\177", 6};
+const ScanRanges HIGH_BIT{"\200\377", 2};
+const ScanRanges ONE_CHAR{"::", 2};
+const ScanRanges ALL_BYTES{"\000\377", 2};
+
+
+// 没有匹配、只有最后一个字节匹配、每个位置单独匹配
+void edge_test() {
+    cout << "----------scan edge cases-----------" << endl;
+    for (size_t len = 0; len <= MAX_LEN; ++len) {
+        string plain(len, 'a');
+        check_all(plain, LINE_END, "no match");
+        check_all(plain, HIGH_BIT, "no match");
+        check_all(plain, ONE_CHAR, "no match");
+        check_all(plain, ALL_BYTES, "all bytes");
+
+        for (size_t pos = 0; pos < len; ++pos) {
+            string input = plain;
+            input[pos] = '\n';
+            check_all(input, LINE_END, "match at " + to_string(pos));
+            input[pos] = ':';
+            check_all(input, ONE_CHAR, "match at " + to_string(pos));
+            input[pos] = '\xff';
+            check_all(input, HIGH_BIT, "match at " + to_string(pos));
+        }
+    }
+
+    // 高位字节: 按无符号比较，0x7f 和 0x80 的边界不能当成负数
+    for (size_t len = 0; len <= MAX_LEN; ++len) {
+        string high(len, '\x80');
+        check_all(high, LINE_END, "high bit");
+        check_all(high, HIGH_BIT, "high bit");
+        string utf8;
+        while (utf8.size() < len) {
+            utf8 += "\xe4\xbd\xa0";
+        }
+        utf8.resize(len);
+        check_all(utf8, LINE_END, "utf8");
+        check_all(utf8 + '\x7f', LINE_END, "utf8 then del");
+        check_all(string(len, '\x7e') + '\x80', HIGH_BIT, "below high bit");
+    }
+}
+
+
+// 随机的 1..8 对区间和随机输入，固定种子保证可重现
+void random_test() {
+    cout << "----------scan random ranges-----------" << endl;
+    mt19937 rng(20240611);
+    uniform_int_distribution<int> byte_dist(0, 255);
+    uniform_int_distribution<int> pairs_dist(1, 8);
+    uniform_int_distribution<size_t> len_dist(0, MAX_LEN);
+
+    for (int round = 0; round < 2000; ++round) {
+        int pairs = pairs_dist(rng);
+        char raw[16];
+        for (int i = 0; i < pairs; ++i) {
+            int lo = byte_dist(rng);
+            // 多数区间较窄，这样输入中既有匹配也有不匹配的字节
+            int hi = min(255, lo + byte_dist(rng) % 16);
+            raw[2 * i] = static_cast<char>(lo);
+            raw[2 * i + 1] = static_cast<char>(hi);
+        }
+        ScanRanges ranges(raw, pairs * 2);
+
+        string input(len_dist(rng), '\0');
+        for (char &c: input) {
+            c = static_cast<char>(byte_dist(rng));
+        }
+        check_all(input, ranges, "random round " + to_string(round));
+
+        // 去掉所有匹配的字节，只在最后一个字节放一个匹配
+        for (char &c: input) {
+            while (ranges.table[static_cast<unsigned char>(c)]) {
+                c = static_cast<char>(c + 17);
+            }
+        }
+        check_all(input, ranges, "random no match " + to_string(round));
+        if (!input.empty()) {
+            input.back() = raw[2 * (round % pairs) + 1];
+            check_all(input, ranges, "random last byte " + to_string(round));
+        }
+    }
+}
+
+
+int main() {
+    cout << "backends:";
+    for (const ScanBackend &backend: backends) {
+        cout << " " << backend.name;
+    }
+    cout << ", using " << scan_backend_name() << endl;
+    CHECK(!backends.empty());
+
+    edge_test();
+    random_test();
+    return test_result();
+}
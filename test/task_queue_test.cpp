@@ -0,0 +1,173 @@
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "TaskQueue.h"
+#include "TestCheck.h"
+
+using namespace std;
+
+
+// 统计 TaskNode 大小的分配次数，用来确认节点来自节点池而不是每次 new
+atomic<size_t> g_node_allocs{0};
+
+void *operator new(size_t size) {
+    if (size == sizeof(TaskNode)) {
+        g_node_allocs.fetch_add(1, memory_order_relaxed);
+    }
+    if (void *p = malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+
+constexpr size_t PRODUCERS = 4;
+constexpr size_t TASKS_PER_PRODUCER = 200000;
+constexpr size_t WINDOW = 256;   // 每个生产者最多有这么多任务还没有执行
+constexpr size_t HEAP_EVERY = 7;   // 每隔几个任务投递一个超过 INLINE_SIZE 的任务
+
+// 只在消费者线程读写
+struct ConsumerState {
+    vector<size_t> next_seq = vector<size_t>(PRODUCERS, 0);
+    size_t out_of_order{0};
+    size_t bad_payload{0};
+};
+
+
+// 多个生产者并发 push，一个消费者循环 run_all。
+// 检查每个生产者的任务按投递顺序执行、不丢失、不重复，执行完的节点被重复使用
+void stress_test() {
+    cout << "----------task queue multi-producer stress-----------" << endl;
+    static_assert(sizeof(array<char, 128>) > TaskNode::INLINE_SIZE);
+
+    TaskQueue queue;
+    ConsumerState state;
+    vector<atomic<size_t>> executed(PRODUCERS);   // 每个生产者已经执行的任务数，用于限流
+    atomic<bool> producers_done{false};
+    size_t allocs_before = g_node_allocs.load();
+
+    thread consumer([&]() {
+        size_t total = 0;
+        while (true) {
+            bool done = producers_done.load(memory_order_acquire);
+            size_t count = queue.run_all();
+            total += count;
+            if (done && count == 0) {
+                break;
+            }
+            if (count == 0) {
+                this_thread::yield();
+            }
+        }
+        CHECK_EQ(total, PRODUCERS * TASKS_PER_PRODUCER);
+    });
+
+    vector<thread> producers;
+    for (size_t id = 0; id < PRODUCERS; ++id) {
+        producers.emplace_back([&, id]() {
+            for (size_t seq = 0; seq < TASKS_PER_PRODUCER; ++seq) {
+                while (seq - executed[id].load(memory_order_acquire) >= WINDOW) {
+                    this_thread::yield();
+                }
+                auto check_order = [&state, &executed, id, seq]() {
+                    if (state.next_seq[id] != seq) {
+                        ++state.out_of_order;
+                    }
+                    state.next_seq[id] = seq + 1;
+                    executed[id].store(seq + 1, memory_order_release);
+                };
+                if (seq % HEAP_EVERY == 0) {
+                    array<char, 128> payload;
+                    payload.fill(static_cast<char>(seq));
+                    queue.push([check_order, payload, seq, &state]() {
+                        for (char c: payload) {
+                            if (c != static_cast<char>(seq)) {
+                                ++state.bad_payload;
+                                break;
+                            }
+                        }
+                        check_order();
+                    });
+                } else {
+                    queue.push(check_order);
+                }
+            }
+        });
+    }
+    for (thread &producer: producers) {
+        producer.join();
+    }
+    producers_done.store(true, memory_order_release);
+    consumer.join();
+
+    CHECK_EQ(state.out_of_order, 0u);
+    CHECK_EQ(state.bad_payload, 0u);
+    for (size_t id = 0; id < PRODUCERS; ++id) {
+        CHECK_EQ(state.next_seq[id], TASKS_PER_PRODUCER);
+    }
+
+    // 没有节点池时每个任务分配一次。生产者缓存中的节点数量取决于线程调度，这里只要求远少于任务数
+    size_t allocs = g_node_allocs.load() - allocs_before;
+    cout << "TaskNode allocations: " << allocs << " for " << PRODUCERS * TASKS_PER_PRODUCER << " tasks" << endl;
+    CHECK(allocs <= PRODUCERS * TASKS_PER_PRODUCER / 10);
+}
+
+
+// 同一个线程中执行完的节点再次投递时直接复用
+void reuse_test() {
+    cout << "----------task queue node reuse-----------" << endl;
+    TaskQueue queue;
+    int sum = 0;
+    for (int i = 0; i < 8; ++i) {
+        queue.push([&sum, i]() { sum += i; });
+    }
+    CHECK_EQ(queue.run_all(), 8u);
+    CHECK_EQ(sum, 28);
+
+    size_t allocs_before = g_node_allocs.load();
+    for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < 8; ++i) {
+            queue.push([&sum]() { ++sum; });
+        }
+        CHECK_EQ(queue.run_all(), 8u);
+    }
+    CHECK_EQ(sum, 28 + 800);
+    CHECK_EQ(g_node_allocs.load() - allocs_before, 0u);
+    CHECK_EQ(queue.run_all(), 0u);
+}
+
+
+// 析构时队列中没有执行的任务只析构不执行，内联和堆上的可调用对象都要释放
+void discard_test() {
+    cout << "----------task queue discard on destruction-----------" << endl;
+    auto token = make_shared<int>(0);
+    int runs = 0;
+    {
+        TaskQueue queue;
+        for (int i = 0; i < 10; ++i) {
+            queue.push([token, &runs]() { ++runs; });
+            array<char, 128> payload{};
+            queue.push([token, payload, &runs]() { runs += payload[0] + 1; });
+        }
+        CHECK_EQ(token.use_count(), 21);
+    }
+    CHECK_EQ(runs, 0);
+    CHECK_EQ(token.use_count(), 1);
+}
+
+
+int main() {
+    stress_test();
+    reuse_test();
+    discard_test();
+    return test_result();
+}
@@ -0,0 +1,228 @@
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "Clock.h"
+#include "TestCheck.h"
+#include "Timer.h"
+
+using namespace std;
+
+
+// 时间轮各层的边界，和 TimerManager 中的 TVR_BITS / TVN_BITS 对应
+constexpr uint64_t TV1_SPAN = 1ULL << 8;
+constexpr uint64_t TV2_SPAN = 1ULL << 14;
+constexpr uint64_t TV3_SPAN = 1ULL << 20;
+
+
+struct Probe {
+    TimerNode node;
+    uint64_t expected{0};
+    uint64_t fired_at{0};
+    int fired{0};
+};
+
+
+// 起点不对齐，第一次 cascade 在几个 tick 之后
+constexpr uint64_t BASE = 5 * TV3_SPAN + 3 * TV2_SPAN + 250;
+
+// 每一层的边界前后，以及跨越多层的超时
+const vector<uint64_t> TIMEOUTS = {
+    0, 1, 5, 6, 7,
+    TV1_SPAN - 1, TV1_SPAN, TV1_SPAN + 1, 300, 3 * TV1_SPAN + 17,
+    TV2_SPAN - 1, TV2_SPAN, TV2_SPAN + 1, 20000, 5 * TV2_SPAN + 255,
+    TV3_SPAN - 1, TV3_SPAN, TV3_SPAN + 1, 2 * TV3_SPAN, 3 * TV3_SPAN + 77,
+};
+
+
+// 在 BASE 时刻为每个超时挂一个定时器
+vector<unique_ptr<Probe>> add_probes(TimerManager &manager) {
+    vector<unique_ptr<Probe>> probes;
+    for (uint64_t timeout: TIMEOUTS) {
+        auto probe = make_unique<Probe>();
+        Probe *p = probe.get();
+        p->expected = BASE + timeout;
+        p->node.set_callback([p]() {
+            p->fired_at = Clock::now_ms();
+            ++p->fired;
+        });
+        manager.add_timer(p->node, static_cast<int>(timeout));
+        probes.push_back(std::move(probe));
+    }
+    return probes;
+}
+
+
+// 每次前进 step ms，到期的定时器在第一次 now >= expected 的处理中触发
+void step_test(uint64_t step) {
+    cout << "----------timer wheel step " << step << " ms-----------" << endl;
+    Clock::set_now_ms(BASE);
+    TimerManager manager;
+    vector<unique_ptr<Probe>> probes = add_probes(manager);
+    CHECK_EQ(manager.size(), TIMEOUTS.size());
+
+    uint64_t end = BASE + TIMEOUTS.back() + step;
+    for (uint64_t now = BASE; now <= end; now += step) {
+        Clock::set_now_ms(now);
+        manager.handle_expired_event();
+    }
+
+    // 不会提前触发，也不会晚于到期之后的第一次处理
+    for (const auto &p: probes) {
+        if (p->fired != 1 || p->fired_at < p->expected || p->fired_at >= p->expected + step) {
+            cerr << "timeout " << p->expected - BASE << " fired " << p->fired << " time(s), at +"
+                 << p->fired_at - BASE << endl;
+        }
+        CHECK_EQ(p->fired, 1);
+        CHECK(p->fired_at >= p->expected);
+        CHECK(p->fired_at < p->expected + step);
+    }
+    CHECK_EQ(manager.size(), 0u);
+}
+
+
+// 按 next_timeout 跳到下一次需要处理的时刻，和 EventLoop 一样。不能睡过任何一个到期时间
+void next_timeout_test() {
+    cout << "----------timer wheel next_timeout-----------" << endl;
+    Clock::set_now_ms(BASE);
+    TimerManager manager;
+    vector<unique_ptr<Probe>> probes = add_probes(manager);
+
+    const int max_timeout = 1 << 30;
+    uint64_t now = BASE;
+    size_t wakeups = 0;
+    manager.handle_expired_event();
+    while (manager.size() > 0 && wakeups < 100000) {
+        int timeout = manager.next_timeout(max_timeout);
+        CHECK(timeout >= 0);
+        now += static_cast<uint64_t>(timeout);
+        Clock::set_now_ms(now);
+        manager.handle_expired_event();
+        ++wakeups;
+    }
+
+    for (const auto &p: probes) {
+        CHECK_EQ(p->fired, 1);
+        CHECK_EQ(p->fired_at, p->expected);
+    }
+    // 高层的槽在 cascade 时多唤醒一次，不是逐个 tick 轮询
+    CHECK(wakeups <= 4 * TIMEOUTS.size());
+    CHECK_EQ(manager.next_timeout(max_timeout), max_timeout);
+}
+
+
+// 在发生 cascade 的 tick 中，回调取消刚从高层移下来的定时器、同一个槽中排在后面的定时器和仍在高层的定时器
+void cancel_in_cascade_test() {
+    cout << "----------timer wheel cancel in cascade-----------" << endl;
+    // tv2 -> tv1 的 cascade 发生在 TV1_SPAN 的整数倍，tv3 -> tv2 -> tv1 发生在 TV2_SPAN 的整数倍
+    const uint64_t base = 7 * TV2_SPAN + 100;
+    const uint64_t tv2_boundary = base - 100 + 4 * TV1_SPAN;   // 不是 TV2_SPAN 的整数倍
+    const uint64_t tv3_boundary = 9 * TV2_SPAN;
+    Clock::set_now_ms(base);
+    TimerManager manager;
+
+    Probe a, b, d, e, f, g, h, i;
+    auto add = [&](Probe &p, uint64_t expire) {
+        p.expected = expire;
+        manager.add_timer(p.node, static_cast<int>(expire - base));
+    };
+    auto record = [](Probe &p) {
+        return [&p]() {
+            p.fired_at = Clock::now_ms();
+            ++p.fired;
+        };
+    };
+
+    // tv2 -> tv1: a、f、b、d 在同一个 tv2 槽中，在 tv2_boundary 被 cascade 到 tv1
+    a.node.set_callback([&]() {
+        a.fired_at = Clock::now_ms();
+        ++a.fired;
+        if (a.fired == 1) {
+            f.node.cancel();    // 同一个 tick，排在 a 之后，已经从槽中取出
+            b.node.cancel();    // 刚被 cascade 到 tv1
+            e.node.cancel();    // 仍在 tv4
+            manager.add_timer(a.node, 100);   // 回调中重新添加自己
+        }
+    });
+    f.node.set_callback(record(f));
+    b.node.set_callback(record(b));
+    d.node.set_callback(record(d));
+    e.node.set_callback(record(e));
+    add(a, tv2_boundary);
+    add(f, tv2_boundary);
+    add(b, tv2_boundary + 10);
+    add(d, tv2_boundary + TV1_SPAN - 1);
+    add(e, base + 3 * TV3_SPAN);
+
+    // tv3 -> tv1: g、h、i 在同一个 tv3 槽中，在 tv3_boundary 先 cascade tv2 再 cascade tv3，
+    // g、h 直接落到 tv1，i 落到 tv2
+    g.node.set_callback([&]() {
+        g.fired_at = Clock::now_ms();
+        ++g.fired;
+        h.node.cancel();
+    });
+    h.node.set_callback(record(h));
+    i.node.set_callback(record(i));
+    add(g, tv3_boundary);
+    add(h, tv3_boundary + 5);
+    add(i, tv3_boundary + 300);
+
+    CHECK_EQ(manager.size(), 8u);
+    for (uint64_t now = base; now <= tv3_boundary + TV2_SPAN; ++now) {
+        Clock::set_now_ms(now);
+        manager.handle_expired_event();
+    }
+
+    CHECK_EQ(a.fired, 2);
+    CHECK_EQ(a.fired_at, tv2_boundary + 100);
+    CHECK_EQ(f.fired, 0);
+    CHECK_EQ(b.fired, 0);
+    CHECK_EQ(d.fired, 1);
+    CHECK_EQ(d.fired_at, d.expected);
+    CHECK_EQ(g.fired, 1);
+    CHECK_EQ(g.fired_at, g.expected);
+    CHECK_EQ(h.fired, 0);
+    CHECK_EQ(i.fired, 1);
+    CHECK_EQ(i.fired_at, i.expected);
+    CHECK(!b.node.is_linked());
+    CHECK(!e.node.is_linked());
+    CHECK(!h.node.is_linked());
+    // e 被取消之后时间轮为空，a 的第二次触发之后没有再添加
+    CHECK_EQ(manager.size(), 0u);
+}
+
+
+// 挂在时间轮上的节点重新 add_timer 只是移动，不会重复计数或触发两次
+void readd_test() {
+    cout << "----------timer wheel re-add-----------" << endl;
+    Clock::set_now_ms(BASE);
+    TimerManager manager;
+    Probe p;
+    p.node.set_callback([&p]() {
+        p.fired_at = Clock::now_ms();
+        ++p.fired;
+    });
+    manager.add_timer(p.node, static_cast<int>(TV3_SPAN));
+    manager.add_timer(p.node, static_cast<int>(TV2_SPAN));
+    manager.add_timer(p.node, 50);
+    CHECK_EQ(manager.size(), 1u);
+    for (uint64_t now = BASE; now <= BASE + TV3_SPAN + 1; now += 7) {
+        Clock::set_now_ms(now);
+        manager.handle_expired_event();
+    }
+    CHECK_EQ(p.fired, 1);
+    CHECK(p.fired_at >= BASE + 50 && p.fired_at < BASE + 57);
+    CHECK_EQ(manager.size(), 0u);
+}
+
+
+int main() {
+    step_test(1);
+    step_test(7);
+    step_test(1000);
+    next_timeout_test();
+    cancel_in_cascade_test();
+    readd_test();
+    return test_result();
+}